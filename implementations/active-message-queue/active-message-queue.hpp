@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../lib/comm.hpp"
+#include "../lib/window_layout.hpp"
 #include <cstdint>
 #include <cstdlib>
 #include <mpi.h>
@@ -15,31 +16,38 @@ private:
   const MPI_Aint _dequeuer_rank;
   const MPI_Aint _capacity;
 
-  MPI_Win _data_0_win = MPI_WIN_NULL;
+  // Every region is hosted by the dequeuer. The items are in their own
+  // window, apart from the counters in _win.
+  MPI_Win _win = MPI_WIN_NULL;
+  MPI_Win _data_win = MPI_WIN_NULL;
+
+  WindowLayout::Region<T> _data_0_region;
   T *_data_0_ptr = nullptr;
 
-  MPI_Win _data_1_win = MPI_WIN_NULL;
+  WindowLayout::Region<T> _data_1_region;
   T *_data_1_ptr = nullptr;
 
-  MPI_Win _queue_num_win = MPI_WIN_NULL;
+  WindowLayout::Region<bool> _queue_num_region;
   bool *_queue_num_ptr = nullptr;
 
-  MPI_Win _writer_count_0_win = MPI_WIN_NULL;
+  WindowLayout::Region<int64_t> _writer_count_0_region;
   int64_t *_writer_count_0_ptr = nullptr;
 
-  MPI_Win _writer_count_1_win = MPI_WIN_NULL;
+  WindowLayout::Region<int64_t> _writer_count_1_region;
   int64_t *_writer_count_1_ptr = nullptr;
 
   bool _prev_queue_num; // Dequeuer-specific
 
-  MPI_Win _offset_0_win = MPI_WIN_NULL;
+  WindowLayout::Region<MPI_Aint> _offset_0_region;
   MPI_Aint *_offset_0_ptr = nullptr;
 
-  MPI_Win _offset_1_win = MPI_WIN_NULL;
+  WindowLayout::Region<MPI_Aint> _offset_1_region;
   MPI_Aint *_offset_1_ptr = nullptr;
 
   MPI_Info _info = MPI_INFO_NULL;
 
+  queue_stats_t _stats = {};
+
 public:
   AMQueue(MPI_Aint capacity, MPI_Aint dequeuer_rank, MPI_Comm comm)
       : _comm{comm}, _dequeuer_rank{dequeuer_rank}, _capacity{capacity} {
@@ -48,73 +56,42 @@ public:
     MPI_Info_set(this->_info, "same_disp_unit", "true");
     MPI_Info_set(this->_info, "accumulate_ordering", "none");
 
-    if (this->_self_rank == this->_dequeuer_rank) {
-      MPI_Win_allocate(capacity * sizeof(T), sizeof(T), this->_info, comm,
-                       &this->_data_0_ptr, &this->_data_0_win);
-      MPI_Win_allocate(capacity * sizeof(T), sizeof(T), this->_info, comm,
-                       &this->_data_1_ptr, &this->_data_1_win);
-      MPI_Win_allocate(sizeof(int64_t), sizeof(MPI_Aint), this->_info, comm,
-                       &this->_writer_count_0_ptr, &this->_writer_count_0_win);
-      MPI_Win_allocate(sizeof(int64_t), sizeof(MPI_Aint), this->_info, comm,
-                       &this->_writer_count_1_ptr, &this->_writer_count_1_win);
-      MPI_Win_allocate(sizeof(MPI_Aint), sizeof(MPI_Aint), this->_info, comm,
-                       &this->_offset_0_ptr, &this->_offset_0_win);
-      MPI_Win_allocate(sizeof(MPI_Aint), sizeof(MPI_Aint), this->_info, comm,
-                       &this->_offset_1_ptr, &this->_offset_1_win);
-      MPI_Win_allocate(sizeof(bool), sizeof(bool), this->_info, comm,
-                       &this->_queue_num_ptr, &this->_queue_num_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _data_0_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _data_1_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _writer_count_0_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _writer_count_1_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _offset_0_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _offset_1_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _queue_num_win);
+    const bool is_dequeuer = this->_self_rank == this->_dequeuer_rank;
+    WindowLayout layout;
+    this->_queue_num_region = layout.add<bool>(1, is_dequeuer);
+    this->_writer_count_0_region = layout.add<int64_t>(1, is_dequeuer);
+    this->_writer_count_1_region = layout.add<int64_t>(1, is_dequeuer);
+    this->_offset_0_region = layout.add<MPI_Aint>(1, is_dequeuer);
+    this->_offset_1_region = layout.add<MPI_Aint>(1, is_dequeuer);
+    void *base = layout.allocate(this->_info, comm, &this->_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_win);
+    WindowLayout data_layout;
+    this->_data_0_region = data_layout.add<T>(capacity, is_dequeuer);
+    this->_data_1_region = data_layout.add<T>(capacity, is_dequeuer);
+    void *data_base = data_layout.allocate(this->_info, comm, &this->_data_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_data_win);
+
+    if (is_dequeuer) {
+      this->_queue_num_ptr = this->_queue_num_region.ptr(base);
+      this->_writer_count_0_ptr = this->_writer_count_0_region.ptr(base);
+      this->_writer_count_1_ptr = this->_writer_count_1_region.ptr(base);
+      this->_offset_0_ptr = this->_offset_0_region.ptr(base);
+      this->_offset_1_ptr = this->_offset_1_region.ptr(base);
+      this->_data_0_ptr = this->_data_0_region.ptr(data_base);
+      this->_data_1_ptr = this->_data_1_region.ptr(data_base);
       this->_prev_queue_num = false;
       *this->_writer_count_0_ptr = 0;
       *this->_writer_count_1_ptr = 0;
       *this->_offset_0_ptr = 0;
       *this->_offset_1_ptr = 0;
       *this->_queue_num_ptr = false;
-    } else {
-      MPI_Win_allocate(0, sizeof(T), this->_info, comm, &this->_data_0_ptr,
-                       &this->_data_0_win);
-      MPI_Win_allocate(0, sizeof(T), this->_info, comm, &this->_data_1_ptr,
-                       &this->_data_1_win);
-      MPI_Win_allocate(0, sizeof(int64_t), this->_info, comm,
-                       &this->_writer_count_0_ptr, &this->_writer_count_0_win);
-      MPI_Win_allocate(0, sizeof(int64_t), this->_info, comm,
-                       &this->_writer_count_1_ptr, &this->_writer_count_1_win);
-      MPI_Win_allocate(0, sizeof(MPI_Aint), this->_info, comm,
-                       &this->_offset_0_ptr, &this->_offset_0_win);
-      MPI_Win_allocate(0, sizeof(MPI_Aint), this->_info, comm,
-                       &this->_offset_1_ptr, &this->_offset_1_win);
-      MPI_Win_allocate(0, sizeof(bool), this->_info, comm,
-                       &this->_queue_num_ptr, &this->_queue_num_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _data_0_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _data_1_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _writer_count_0_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _writer_count_1_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _offset_0_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _offset_1_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _queue_num_win);
     }
 
-    MPI_Win_flush_all(this->_data_0_win);
-    MPI_Win_flush_all(this->_data_1_win);
-    MPI_Win_flush_all(this->_writer_count_0_win);
-    MPI_Win_flush_all(this->_writer_count_1_win);
-    MPI_Win_flush_all(this->_offset_0_win);
-    MPI_Win_flush_all(this->_offset_1_win);
-    MPI_Win_flush_all(this->_queue_num_win);
+    MPI_Win_flush_all(this->_win);
+    MPI_Win_flush_all(this->_data_win);
     MPI_Barrier(comm);
-    MPI_Win_flush_all(this->_data_0_win);
-    MPI_Win_flush_all(this->_data_1_win);
-    MPI_Win_flush_all(this->_writer_count_0_win);
-    MPI_Win_flush_all(this->_writer_count_1_win);
-    MPI_Win_flush_all(this->_offset_0_win);
-    MPI_Win_flush_all(this->_offset_1_win);
-    MPI_Win_flush_all(this->_queue_num_win);
+    MPI_Win_flush_all(this->_win);
+    MPI_Win_flush_all(this->_data_win);
   }
 
   AMQueue(const AMQueue &) = delete;
@@ -123,31 +100,30 @@ public:
   AMQueue(AMQueue &&other) noexcept
       : _comm{other._comm}, _self_rank{other._self_rank},
         _dequeuer_rank{other._dequeuer_rank}, _capacity{other._capacity},
-        _data_0_win{other._data_0_win}, _data_0_ptr{other._data_0_ptr},
-        _data_1_win{other._data_1_win}, _data_1_ptr{other._data_1_ptr},
-        _queue_num_win{other._queue_num_win},
+        _win{other._win}, _data_win{other._data_win},
+        _data_0_region{other._data_0_region},
+        _data_0_ptr{other._data_0_ptr}, _data_1_region{other._data_1_region},
+        _data_1_ptr{other._data_1_ptr},
+        _queue_num_region{other._queue_num_region},
         _queue_num_ptr{other._queue_num_ptr},
-        _writer_count_0_win{other._writer_count_0_win},
+        _writer_count_0_region{other._writer_count_0_region},
         _writer_count_0_ptr{other._writer_count_0_ptr},
-        _writer_count_1_win{other._writer_count_1_win},
+        _writer_count_1_region{other._writer_count_1_region},
         _writer_count_1_ptr{other._writer_count_1_ptr},
         _prev_queue_num{other._prev_queue_num},
-        _offset_0_win{other._offset_0_win}, _offset_0_ptr{other._offset_0_ptr},
-        _offset_1_win{other._offset_1_win}, _offset_1_ptr{other._offset_1_ptr},
-        _info{other._info} {
-    other._data_0_win = MPI_WIN_NULL;
+        _offset_0_region{other._offset_0_region},
+        _offset_0_ptr{other._offset_0_ptr},
+        _offset_1_region{other._offset_1_region},
+        _offset_1_ptr{other._offset_1_ptr}, _info{other._info},
+        _stats{other._stats} {
+    other._win = MPI_WIN_NULL;
+    other._data_win = MPI_WIN_NULL;
     other._data_0_ptr = nullptr;
-    other._data_1_win = MPI_WIN_NULL;
     other._data_1_ptr = nullptr;
-    other._queue_num_win = MPI_WIN_NULL;
     other._queue_num_ptr = nullptr;
-    other._writer_count_0_win = MPI_WIN_NULL;
     other._writer_count_0_ptr = nullptr;
-    other._writer_count_1_win = MPI_WIN_NULL;
     other._writer_count_1_ptr = nullptr;
-    other._offset_0_win = MPI_WIN_NULL;
     other._offset_0_ptr = nullptr;
-    other._offset_1_win = MPI_WIN_NULL;
     other._offset_1_ptr = nullptr;
     other._info = MPI_INFO_NULL;
   }
@@ -157,95 +133,113 @@ public:
       MPI_Info_free(&_info);
     }
 
-    if (_data_0_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_data_0_win);
-      MPI_Win_free(&_data_0_win);
-    }
-    if (_data_1_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_data_1_win);
-      MPI_Win_free(&_data_1_win);
+    if (_win != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(_win);
+      win_free(&_win);
     }
-    if (_writer_count_0_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_writer_count_0_win);
-      MPI_Win_free(&_writer_count_0_win);
+    if (_data_win != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(_data_win);
+      win_free(&_data_win);
     }
-    if (_writer_count_1_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_writer_count_1_win);
-      MPI_Win_free(&_writer_count_1_win);
-    }
-    if (_offset_0_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_offset_0_win);
-      MPI_Win_free(&_offset_0_win);
-    }
-    if (_offset_1_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_offset_1_win);
-      MPI_Win_free(&_offset_1_win);
-    }
-    if (_queue_num_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_queue_num_win);
-      MPI_Win_free(&_queue_num_win);
+  }
+
+  // Collective; empties both buffers in place, reusing the windows. No rank
+  // may access the queue until all ranks have returned.
+  void reset() {
+    if (this->_self_rank == this->_dequeuer_rank) {
+      this->_prev_queue_num = false;
+      *this->_writer_count_0_ptr = 0;
+      *this->_writer_count_1_ptr = 0;
+      *this->_offset_0_ptr = 0;
+      *this->_offset_1_ptr = 0;
+      *this->_queue_num_ptr = false;
     }
+    MPI_Win_flush_all(this->_win);
+    MPI_Win_flush_all(this->_data_win);
+    MPI_Barrier(this->_comm);
+    MPI_Win_flush_all(this->_win);
+    MPI_Win_flush_all(this->_data_win);
   }
 
   bool enqueue(const T &data) {
+    StatsScope stats_scope(this->_stats);
     bool queue_num;
     int64_t writer_count;
     while (true) {
-      aread_sync(&queue_num, 0, this->_dequeuer_rank, this->_queue_num_win);
+      aread_sync(&queue_num, this->_queue_num_region.disp(),
+                 this->_dequeuer_rank, this->_win);
       if (!queue_num) {
-        fetch_and_add_sync(&writer_count, 1, 0, this->_dequeuer_rank,
-                           this->_writer_count_0_win);
+        fetch_and_add_sync(&writer_count, 1,
+                           this->_writer_count_0_region.disp(),
+                           this->_dequeuer_rank, this->_win);
         if (writer_count < 0) {
-          fetch_and_add_sync(&writer_count, -1, 0, this->_dequeuer_rank,
-                             this->_writer_count_0_win);
+          fetch_and_add_sync(&writer_count, -1,
+                             this->_writer_count_0_region.disp(),
+                             this->_dequeuer_rank, this->_win);
           continue;
         }
         break;
       } else {
-        fetch_and_add_sync(&writer_count, 1, 0, this->_dequeuer_rank,
-                           this->_writer_count_1_win);
+        fetch_and_add_sync(&writer_count, 1,
+                           this->_writer_count_1_region.disp(),
+                           this->_dequeuer_rank, this->_win);
         if (writer_count < 0) {
-          fetch_and_add_sync(&writer_count, -1, 0, this->_dequeuer_rank,
-                             this->_writer_count_1_win);
+          fetch_and_add_sync(&writer_count, -1,
+                             this->_writer_count_1_region.disp(),
+                             this->_dequeuer_rank, this->_win);
           continue;
         }
         break;
       }
     }
     MPI_Aint offset;
-    fetch_and_add_sync(&offset, 1, 0, this->_dequeuer_rank,
-                       queue_num ? this->_offset_1_win : this->_offset_0_win);
+    const MPI_Aint offset_disp = queue_num ? this->_offset_1_region.disp()
+                                           : this->_offset_0_region.disp();
+    const MPI_Aint writer_count_disp =
+        queue_num ? this->_writer_count_1_region.disp()
+                  : this->_writer_count_0_region.disp();
+    fetch_and_add_sync(&offset, 1, offset_disp, this->_dequeuer_rank,
+                       this->_win);
     if (offset >= this->_capacity) {
-      fetch_and_add_sync(&offset, -1, 0, this->_dequeuer_rank,
-                         queue_num ? this->_offset_1_win : this->_offset_0_win);
-      fetch_and_add_sync(&writer_count, -1, 0, this->_dequeuer_rank,
-                         queue_num ? this->_writer_count_1_win
-                                   : this->_writer_count_0_win);
+      fetch_and_add_sync(&offset, -1, offset_disp, this->_dequeuer_rank,
+                         this->_win);
+      fetch_and_add_sync(&writer_count, -1, writer_count_disp,
+                         this->_dequeuer_rank, this->_win);
       return false;
     }
 
-    write_async(&data, offset, this->_dequeuer_rank,
-                queue_num ? this->_data_1_win : this->_data_0_win);
-    fetch_and_add_sync(&writer_count, -1, 0, this->_dequeuer_rank,
-                       queue_num ? this->_writer_count_1_win
-                                 : this->_writer_count_0_win);
+    write_async(&data,
+                queue_num ? this->_data_1_region.disp(offset)
+                          : this->_data_0_region.disp(offset),
+                this->_dequeuer_rank, this->_data_win);
+    flush(this->_dequeuer_rank, this->_data_win);
+    fetch_and_add_sync(&writer_count, -1, writer_count_disp,
+                       this->_dequeuer_rank, this->_win);
     return true;
   }
 
   bool dequeue(std::vector<T> &output) {
+    StatsScope stats_scope(this->_stats);
     bool prev_queue_num = this->_prev_queue_num;
     this->_prev_queue_num = !this->_prev_queue_num;
-    write_sync(&this->_prev_queue_num, 0, this->_self_rank,
-               this->_queue_num_win);
+    write_sync(&this->_prev_queue_num, this->_queue_num_region.disp(),
+               this->_self_rank, this->_win);
+    const MPI_Aint writer_count_disp =
+        prev_queue_num ? this->_writer_count_1_region.disp()
+                       : this->_writer_count_0_region.disp();
+    int64_t *writer_count_ptr =
+        prev_queue_num ? this->_writer_count_1_ptr : this->_writer_count_0_ptr;
     int64_t writer_count;
-    fetch_and_add_sync(&writer_count, -LARGE_NUMBER, 0, this->_self_rank,
-                       prev_queue_num ? this->_writer_count_1_win
-                                      : this->_writer_count_0_win);
+    fetch_and_add_sync(&writer_count, -LARGE_NUMBER, writer_count_disp,
+                       this->_self_rank, this->_win);
+    // Poll the hosted count with local loads: RMA to itself on the window the
+    // enqueuers target would keep them from progressing with some MPI
+    // implementations (e.g. Open MPI's osc pt2pt).
     while (writer_count > -LARGE_NUMBER) {
-      fetch_and_add_sync(&writer_count, 0, 0, this->_self_rank,
-                         prev_queue_num ? this->_writer_count_1_win
-                                        : this->_writer_count_0_win);
+      MPI_Win_sync(this->_win);
+      writer_count = __atomic_load_n(writer_count_ptr, __ATOMIC_SEQ_CST);
     }
+    MPI_Win_sync(this->_data_win);
     MPI_Aint offset;
     if (prev_queue_num) {
       offset = *this->_offset_1_ptr;
@@ -262,14 +256,13 @@ public:
         output.push_back(this->_data_0_ptr[i]);
       }
     }
-
-    if (prev_queue_num) {
-      flush(this->_self_rank, this->_offset_1_win);
-      flush(this->_self_rank, this->_writer_count_1_win);
-    } else {
-      flush(this->_self_rank, this->_offset_0_win);
-      flush(this->_self_rank, this->_writer_count_0_win);
+    if (offset == 0) {
+      stats_count_empty_dequeue();
     }
+
+    flush(this->_self_rank, this->_win);
     return true;
   }
+
+  queue_stats_t stats() const { return this->_stats; }
 };
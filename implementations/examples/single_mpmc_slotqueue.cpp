@@ -0,0 +1,33 @@
+#include "../slotqueue/mpmc-slotqueue.hpp"
+#include <cstdio>
+#include <mpi.h>
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  int rank;
+  int size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  {
+    MpmcSlotQueue<int> queue(1000, 0, MPI_COMM_WORLD);
+    for (int i = 0; i < 50; ++i) {
+      if (!queue.enqueue(i)) {
+        printf("Enqueue failed \n");
+      }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0 || rank == 1) {
+      for (int i = 0; i < 50 * size / 2; ++i) {
+        int value;
+        if (queue.dequeue(&value)) {
+          printf("rank %d dequeue %d\n", rank, value);
+        } else {
+          printf("rank %d dequeue NULL\n", rank);
+        }
+      }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+
+  MPI_Finalize();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <mpi.h>
+
+// Index of the first minimum in values[0, size), or -1 if size is 0.
+// The minimum is first reduced over independent lanes so that the compiler can
+// vectorize the loop, then a second pass locates its first occurrence.
+template <typename T>
+inline MPI_Aint argmin(const T *values, MPI_Aint size) {
+  if (size <= 0) {
+    return -1;
+  }
+
+  constexpr int LANES = 8;
+  T lanes[LANES];
+  for (int l = 0; l < LANES; ++l) {
+    lanes[l] = values[0];
+  }
+  MPI_Aint i = 0;
+  for (; i + LANES <= size; i += LANES) {
+    for (int l = 0; l < LANES; ++l) {
+      lanes[l] = values[i + l] < lanes[l] ? values[i + l] : lanes[l];
+    }
+  }
+  T min_value = lanes[0];
+  for (int l = 1; l < LANES; ++l) {
+    min_value = lanes[l] < min_value ? lanes[l] : min_value;
+  }
+  for (; i < size; ++i) {
+    min_value = values[i] < min_value ? values[i] : min_value;
+  }
+
+  for (MPI_Aint j = 0; j < size; ++j) {
+    if (values[j] == min_value) {
+      return j;
+    }
+  }
+  return -1;
+}
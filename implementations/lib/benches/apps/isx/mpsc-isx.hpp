@@ -35,13 +35,28 @@ inline void slotqueue_isx_sort(unsigned long long number_of_elements,
   const int slice_size = 1 + MAX_NUM / BCL::nprocs();
 
   auto t1 = std::chrono::high_resolution_clock::now();
+  // The queues are carved from one arena, so building them costs a single
+  // barrier instead of several collectives per queue. Every iteration reuses
+  // them.
+  const MPI_Aint arena_size =
+      BCL::nprocs() *
+      SlotQueue<int>::arena_size(number_of_elements, BCL::nprocs());
+  QueueArena arena(arena_size, MPI_COMM_WORLD);
+  std::vector<SlotQueue<int>> queues;
+  queues.reserve(BCL::nprocs());
+  for (size_t rank = 0; rank < BCL::nprocs(); rank++) {
+    queues.push_back(SlotQueue<int>(number_of_elements, rank, arena));
+  }
+  arena.fence();
   for (int _ = 0; _ < iterations; ++_) {
-    std::vector<std::vector<int>> buffers(BCL::nprocs());
-    std::vector<SlotQueue<int>> queues;
-    for (size_t rank = 0; rank < BCL::nprocs(); rank++) {
-      queues.push_back(
-          SlotQueue<int>(number_of_elements, rank, MPI_COMM_WORLD));
+    // The previous iteration's queues are idle since its closing barrier.
+    if (_ > 0) {
+      for (SlotQueue<int> &queue : queues) {
+        queue.reset_local();
+      }
+      BCL::barrier();
     }
+    std::vector<std::vector<int>> buffers(BCL::nprocs());
 
     const int batch_size = 1024;
 
@@ -56,20 +71,22 @@ inline void slotqueue_isx_sort(unsigned long long number_of_elements,
       int slice_index = num / slice_size;
       buffers[slice_index].push_back(num);
       if (buffers[slice_index].size() >= batch_size) {
-        queues[slice_index].enqueue(buffers[slice_index]);
+        queues[slice_index].enqueue_deferred(buffers[slice_index]);
+        queues[slice_index].progress();
         buffers[slice_index].clear();
       }
     }
 
     for (unsigned long long i = 0; i < buffers.size(); i++) {
-      queues[i].enqueue(buffers[i]);
+      queues[i].enqueue_deferred(buffers[i]);
+    }
+    for (unsigned long long i = 0; i < queues.size(); i++) {
+      queues[i].wait_all();
     }
 
     BCL::barrier();
-    int output;
     std::vector<int> my_keys;
-    while (queues[BCL::my_rank].dequeue(&output)) {
-      my_keys.push_back(output);
+    while (queues[BCL::my_rank].dequeue(my_keys, batch_size)) {
     }
     std::sort(my_keys.begin(), my_keys.end());
     BCL::barrier();
@@ -93,13 +110,28 @@ inline void ltqueue_isx_sort(unsigned long long number_of_elements,
   const int slice_size = 1 + MAX_NUM / BCL::nprocs();
 
   auto t1 = std::chrono::high_resolution_clock::now();
+  // The queues are carved from one arena, so building them costs a single
+  // barrier instead of several collectives per queue. Every iteration reuses
+  // them.
+  const MPI_Aint arena_size =
+      BCL::nprocs() *
+      LTQueue<int>::arena_size(number_of_elements, BCL::nprocs());
+  QueueArena arena(arena_size, MPI_COMM_WORLD);
+  std::vector<LTQueue<int>> queues;
+  queues.reserve(BCL::nprocs());
+  for (size_t rank = 0; rank < BCL::nprocs(); rank++) {
+    queues.push_back(LTQueue<int>(number_of_elements, rank, arena));
+  }
+  arena.fence();
   for (int _ = 0; _ < iterations; ++_) {
-    std::vector<std::vector<int>> buffers(BCL::nprocs());
-    std::vector<LTQueue<int>> queues;
-    for (size_t rank = 0; rank < BCL::nprocs(); rank++) {
-      queues.push_back(
-          LTQueue<int>(number_of_elements, rank, MPI_COMM_WORLD));
+    // The previous iteration's queues are idle since its closing barrier.
+    if (_ > 0) {
+      for (LTQueue<int> &queue : queues) {
+        queue.reset_local();
+      }
+      BCL::barrier();
     }
+    std::vector<std::vector<int>> buffers(BCL::nprocs());
 
     const int batch_size = 1024;
 
@@ -114,13 +146,17 @@ inline void ltqueue_isx_sort(unsigned long long number_of_elements,
       int slice_index = num / slice_size;
       buffers[slice_index].push_back(num);
       if (buffers[slice_index].size() >= batch_size) {
-        queues[slice_index].enqueue(buffers[slice_index]);
+        queues[slice_index].enqueue_deferred(buffers[slice_index]);
+        queues[slice_index].progress();
         buffers[slice_index].clear();
       }
     }
 
     for (unsigned long long i = 0; i < buffers.size(); i++) {
-      queues[i].enqueue(buffers[i]);
+      queues[i].enqueue_deferred(buffers[i]);
+    }
+    for (unsigned long long i = 0; i < queues.size(); i++) {
+      queues[i].wait_all();
     }
 
     BCL::barrier();
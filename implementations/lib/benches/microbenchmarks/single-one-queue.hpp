@@ -10,12 +10,17 @@
 #include "../../ltqueue/ltqueue-unbounded.hpp"
 #include "../../ltqueue/ltqueue.hpp"
 #include "../../ltqueue/naive-ltqueue-unbounded.hpp"
+#include "../../slotqueue/hierarchical-slotqueue.hpp"
 #include "../../slotqueue/hosted-slotqueue.hpp"
 #include "../../slotqueue/slotqueue-node.hpp"
 #include "../../slotqueue/slotqueue-unbounded.hpp"
 #include "../../slotqueue/slotqueue.hpp"
+#include "../../stats.hpp"
+#include <algorithm>
 #include <chrono>
 #include <mpi.h>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 inline static void report_single_one_queue(
@@ -23,7 +28,7 @@ inline static void report_single_one_queue(
     int iterations, double microseconds, double dequeues,
     double successful_dequeues, double dequeue_microseconds, double enqueues,
     double successful_enqueues, double enqueue_microseconds,
-    double enqueue_latency_microseconds) {
+    double enqueue_latency_microseconds, const queue_stats_t &stats = {}) {
   int rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
@@ -40,6 +45,7 @@ inline static void report_single_one_queue(
     printf("Total throughput: %g 10^5ops/s\n",
            (successful_enqueues + successful_dequeues) / microseconds * 10);
   }
+  report_queue_stats(title, stats, MPI_COMM_WORLD);
 }
 
 inline void naive_jiffy_single_one_queue_microbenchmark(
@@ -186,6 +192,7 @@ inline void slotqueue_node_single_one_queue_microbenchmark(
   double total_enqueues_microseconds = 0;
   double total_dequeues_microseconds = 0;
   double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
 
   for (int i = 0; i < iterations; ++i) {
     double local_enqueues = 0;
@@ -214,6 +221,7 @@ inline void slotqueue_node_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
               .count();
       local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     } else {
       SlotNodeQueue<int> queue(elements_per_queue, 0, MPI_COMM_WORLD);
       int warm_up_elements = 5;
@@ -245,6 +253,7 @@ inline void slotqueue_node_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
               .count();
       local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     }
 
     double enqueues = 0;
@@ -295,7 +304,7 @@ inline void slotqueue_node_single_one_queue_microbenchmark(
       "Slotqueue Node", number_of_elements, iterations, total_microseconds,
       total_dequeues, total_successful_dequeues, total_dequeues_microseconds,
       total_enqueues, total_successful_enqueues, total_enqueues_microseconds,
-      total_enqueues_latency_microseconds);
+      total_enqueues_latency_microseconds, total_stats);
 }
 
 inline void unbounded_slotqueue_single_one_queue_microbenchmark(
@@ -314,6 +323,7 @@ inline void unbounded_slotqueue_single_one_queue_microbenchmark(
   double total_enqueues_microseconds = 0;
   double total_dequeues_microseconds = 0;
   double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
 
   for (int i = 0; i < iterations; ++i) {
     double local_enqueues = 0;
@@ -342,6 +352,7 @@ inline void unbounded_slotqueue_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
               .count();
       local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     } else {
       UnboundedSlotQueue<int> queue(0, MPI_COMM_WORLD);
       int warm_up_elements = 5;
@@ -373,6 +384,7 @@ inline void unbounded_slotqueue_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
               .count();
       local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     }
 
     double enqueues = 0;
@@ -423,9 +435,10 @@ inline void unbounded_slotqueue_single_one_queue_microbenchmark(
       "Slotqueue Unbounded", number_of_elements, iterations, total_microseconds,
       total_dequeues, total_successful_dequeues, total_dequeues_microseconds,
       total_enqueues, total_successful_enqueues, total_enqueues_microseconds,
-      total_enqueues_latency_microseconds);
+      total_enqueues_latency_microseconds, total_stats);
 }
 
+template <typename Counter = FaaCounter>
 inline void
 slotqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
                                           int iterations = 10) {
@@ -443,6 +456,7 @@ slotqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
   double total_enqueues_microseconds = 0;
   double total_dequeues_microseconds = 0;
   double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
 
   for (int i = 0; i < iterations; ++i) {
     double local_enqueues = 0;
@@ -454,7 +468,7 @@ slotqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
     double local_dequeues_microseconds = 0;
 
     if (rank == 0) {
-      SlotQueue<int> queue(elements_per_queue, 0, MPI_COMM_WORLD);
+      SlotQueue<int, Counter> queue(elements_per_queue, 0, MPI_COMM_WORLD);
       MPI_Barrier(MPI_COMM_WORLD);
       auto t1 = std::chrono::high_resolution_clock::now();
       while (local_successful_dequeues < number_of_elements) {
@@ -471,8 +485,9 @@ slotqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
           std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
               .count();
       local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     } else {
-      SlotQueue<int> queue(elements_per_queue, 0, MPI_COMM_WORLD);
+      SlotQueue<int, Counter> queue(elements_per_queue, 0, MPI_COMM_WORLD);
       int warm_up_elements = 5;
       auto t1 = std::chrono::high_resolution_clock::now();
       for (unsigned long long i = 0; i < warm_up_elements; ++i) {
@@ -502,6 +517,7 @@ slotqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
           std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
               .count();
       local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     }
 
     double enqueues = 0;
@@ -549,10 +565,193 @@ slotqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
   }
 
   report_single_one_queue(
-      "Slotqueue", number_of_elements, iterations, total_microseconds,
+      std::is_same_v<Counter, ClockCounter> ? "SlotQueue (clock timestamps)"
+                                            : "SlotQueue",
+      number_of_elements, iterations, total_microseconds, total_dequeues,
+      total_successful_dequeues, total_dequeues_microseconds, total_enqueues,
+      total_successful_enqueues, total_enqueues_microseconds,
+      total_enqueues_latency_microseconds, total_stats);
+}
+
+// Measures how far the dequeue order departs from real-time enqueue order:
+// enqueuers tag every item with a global FAA sequence number taken right
+// before the enqueue, and the dequeuer counts items dequeued after an item
+// with a larger sequence number.
+template <typename Counter = FaaCounter>
+inline void
+slotqueue_reordering_microbenchmark(unsigned long long number_of_elements) {
+  int size;
+  int rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  unsigned long long elements_per_queue = number_of_elements / (size - 1) + 1;
+
+  FaaCounter sequence(0, MPI_COMM_WORLD);
+  SlotQueue<int, Counter> queue(elements_per_queue, 0, MPI_COMM_WORLD);
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0) {
+    unsigned long long dequeues = 0;
+    unsigned long long reordered_dequeues = 0;
+    long long max_sequence = -1;
+    long long max_displacement = 0;
+    while (dequeues < elements_per_queue * (size - 1)) {
+      int output;
+      if (!queue.dequeue(&output)) {
+        continue;
+      }
+      ++dequeues;
+      if (output < max_sequence) {
+        ++reordered_dequeues;
+        max_displacement = std::max(max_displacement, max_sequence - output);
+      } else {
+        max_sequence = output;
+      }
+    }
+    printf("---- %s reordering ----\n",
+           std::is_same_v<Counter, ClockCounter> ? "SlotQueue (clock timestamps)"
+                                                 : "SlotQueue");
+    printf("Reordered dequeues: %g%%\n",
+           100.0 * reordered_dequeues / dequeues);
+    printf("Max sequence displacement: %lld\n", max_displacement);
+  } else {
+    for (unsigned long long i = 0; i < elements_per_queue; ++i) {
+      int value = sequence.get_and_increment();
+      while (!queue.enqueue(value)) {
+      }
+    }
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+}
+
+inline void hierarchical_slotqueue_single_one_queue_microbenchmark(
+    unsigned long long number_of_elements, int iterations = 10) {
+  int size;
+  int rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  unsigned long long elements_per_queue = number_of_elements / (size - 1) + 1;
+
+  double total_enqueues = 0;
+  double total_dequeues = 0;
+  double total_successful_enqueues = 0;
+  double total_successful_dequeues = 0;
+  double total_microseconds = 0;
+  double total_enqueues_microseconds = 0;
+  double total_dequeues_microseconds = 0;
+  double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
+
+  for (int i = 0; i < iterations; ++i) {
+    double local_enqueues = 0;
+    double local_dequeues = 0;
+    double local_successful_enqueues = 0;
+    double local_successful_dequeues = 0;
+    double local_microseconds = 0;
+    double local_enqueues_microseconds = 0;
+    double local_dequeues_microseconds = 0;
+
+    if (rank == 0) {
+      HierarchicalSlotQueue<int> queue(elements_per_queue, 0, MPI_COMM_WORLD);
+      MPI_Barrier(MPI_COMM_WORLD);
+      auto t1 = std::chrono::high_resolution_clock::now();
+      while (local_successful_dequeues < number_of_elements) {
+        int output;
+        if (queue.dequeue(&output)) {
+          ++local_dequeues;
+          ++local_successful_dequeues;
+        } else {
+          ++local_dequeues;
+        }
+      }
+      auto t2 = std::chrono::high_resolution_clock::now();
+      local_microseconds =
+          std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
+              .count();
+      local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
+    } else {
+      HierarchicalSlotQueue<int> queue(elements_per_queue, 0, MPI_COMM_WORLD);
+      int warm_up_elements = 5;
+      auto t1 = std::chrono::high_resolution_clock::now();
+      for (unsigned long long i = 0; i < warm_up_elements; ++i) {
+        if (queue.enqueue(i)) {
+          ++local_enqueues;
+          ++local_successful_enqueues;
+        } else {
+          ++local_enqueues;
+        }
+      }
+      auto t2 = std::chrono::high_resolution_clock::now();
+      MPI_Barrier(MPI_COMM_WORLD);
+      auto t3 = std::chrono::high_resolution_clock::now();
+      for (unsigned long long i = 0; i < elements_per_queue - warm_up_elements;
+           ++i) {
+        if (queue.enqueue(i)) {
+          ++local_enqueues;
+          ++local_successful_enqueues;
+        } else {
+          ++local_enqueues;
+        }
+      }
+      auto t4 = std::chrono::high_resolution_clock::now();
+      local_microseconds =
+          std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
+              .count() +
+          std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
+              .count();
+      local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
+    }
+
+    double enqueues = 0;
+    double dequeues = 0;
+    double successful_enqueues = 0;
+    double successful_dequeues = 0;
+    double microseconds = 0;
+    double enqueues_microseconds = 0;
+    double dequeues_microseconds = 0;
+    double enqueues_latency_microseconds = 0;
+
+    MPI_Allreduce(&local_dequeues, &dequeues, 1, MPI_DOUBLE, MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    MPI_Allreduce(&local_enqueues, &enqueues, 1, MPI_DOUBLE, MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    MPI_Allreduce(&local_successful_dequeues, &successful_dequeues, 1,
+                  MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+    MPI_Allreduce(&local_successful_enqueues, &successful_enqueues, 1,
+                  MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+    MPI_Allreduce(&local_microseconds, &microseconds, 1, MPI_DOUBLE, MPI_MAX,
+                  MPI_COMM_WORLD);
+
+    MPI_Allreduce(&local_enqueues_microseconds, &enqueues_microseconds, 1,
+                  MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    enqueues_microseconds /= size - 1;
+
+    MPI_Allreduce(&local_enqueues_microseconds, &enqueues_latency_microseconds,
+                  1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+    MPI_Allreduce(&local_dequeues_microseconds, &dequeues_microseconds, 1,
+                  MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    total_enqueues += enqueues;
+    total_dequeues += dequeues;
+    total_successful_dequeues += successful_dequeues;
+    total_successful_enqueues += successful_enqueues;
+    total_microseconds += microseconds;
+    total_enqueues_microseconds += enqueues_microseconds;
+    total_enqueues_latency_microseconds += enqueues_latency_microseconds;
+    total_dequeues_microseconds += dequeues_microseconds;
+  }
+
+  report_single_one_queue(
+      "Hierarchical Slotqueue", number_of_elements, iterations, total_microseconds,
       total_dequeues, total_successful_dequeues, total_dequeues_microseconds,
       total_enqueues, total_successful_enqueues, total_enqueues_microseconds,
-      total_enqueues_latency_microseconds);
+      total_enqueues_latency_microseconds, total_stats);
 }
 
 inline void
@@ -572,6 +771,7 @@ amqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
   double total_enqueues_microseconds = 0;
   double total_dequeues_microseconds = 0;
   double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
 
   for (int i = 0; i < iterations; ++i) {
     double local_enqueues = 0;
@@ -600,6 +800,7 @@ amqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
           std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
               .count();
       local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     } else {
       AMQueue<int> queue(number_of_elements, 0, MPI_COMM_WORLD);
       int warm_up_elements = 5;
@@ -631,6 +832,7 @@ amqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
           std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
               .count();
       local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     }
 
     double enqueues = 0;
@@ -681,7 +883,7 @@ amqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
       "AMQueue", number_of_elements, iterations, total_microseconds,
       total_dequeues, total_successful_dequeues, total_dequeues_microseconds,
       total_enqueues, total_successful_enqueues, total_enqueues_microseconds,
-      total_enqueues_latency_microseconds);
+      total_enqueues_latency_microseconds, total_stats);
 }
 
 inline void naive_ltqueue_single_one_queue_microbenchmark(
@@ -700,6 +902,7 @@ inline void naive_ltqueue_single_one_queue_microbenchmark(
   double total_enqueues_microseconds = 0;
   double total_dequeues_microseconds = 0;
   double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
 
   for (int i = 0; i < iterations; ++i) {
     double local_enqueues = 0;
@@ -728,6 +931,7 @@ inline void naive_ltqueue_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
               .count();
       local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     } else {
       NaiveUnboundedLTQueue<int> queue(0, MPI_COMM_WORLD);
       int warm_up_elements = 5;
@@ -759,6 +963,7 @@ inline void naive_ltqueue_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
               .count();
       local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     }
 
     double enqueues = 0;
@@ -809,7 +1014,8 @@ inline void naive_ltqueue_single_one_queue_microbenchmark(
       "Naive LTQueue Unbounded", number_of_elements, iterations,
       total_microseconds, total_dequeues, total_successful_dequeues,
       total_dequeues_microseconds, total_enqueues, total_successful_enqueues,
-      total_enqueues_microseconds, total_enqueues_latency_microseconds);
+      total_enqueues_microseconds, total_enqueues_latency_microseconds,
+      total_stats);
 }
 
 inline void unbounded_ltqueue_single_one_queue_microbenchmark(
@@ -828,6 +1034,7 @@ inline void unbounded_ltqueue_single_one_queue_microbenchmark(
   double total_enqueues_microseconds = 0;
   double total_dequeues_microseconds = 0;
   double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
 
   for (int i = 0; i < iterations; ++i) {
     double local_enqueues = 0;
@@ -856,6 +1063,7 @@ inline void unbounded_ltqueue_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
               .count();
       local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     } else {
       UnboundedLTQueue<int> queue(0, MPI_COMM_WORLD);
       int warm_up_elements = 5;
@@ -887,6 +1095,7 @@ inline void unbounded_ltqueue_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
               .count();
       local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     }
 
     double enqueues = 0;
@@ -937,9 +1146,10 @@ inline void unbounded_ltqueue_single_one_queue_microbenchmark(
       "LTQueue Unbounded", number_of_elements, iterations, total_microseconds,
       total_dequeues, total_successful_dequeues, total_dequeues_microseconds,
       total_enqueues, total_successful_enqueues, total_enqueues_microseconds,
-      total_enqueues_latency_microseconds);
+      total_enqueues_latency_microseconds, total_stats);
 }
 
+template <int Fanout = 2>
 inline void
 ltqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
                                         int iterations = 10) {
@@ -957,6 +1167,7 @@ ltqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
   double total_enqueues_microseconds = 0;
   double total_dequeues_microseconds = 0;
   double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
 
   for (int i = 0; i < iterations; ++i) {
     double local_enqueues = 0;
@@ -968,7 +1179,7 @@ ltqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
     double local_dequeues_microseconds = 0;
 
     if (rank == 0) {
-      LTQueue<int> queue(elements_per_queue, 0, MPI_COMM_WORLD);
+      LTQueue<int, Fanout> queue(elements_per_queue, 0, MPI_COMM_WORLD);
       MPI_Barrier(MPI_COMM_WORLD);
       auto t1 = std::chrono::high_resolution_clock::now();
       while (local_successful_dequeues < number_of_elements) {
@@ -985,8 +1196,9 @@ ltqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
           std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
               .count();
       local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     } else {
-      LTQueue<int> queue(elements_per_queue, 0, MPI_COMM_WORLD);
+      LTQueue<int, Fanout> queue(elements_per_queue, 0, MPI_COMM_WORLD);
       int warm_up_elements = 5;
       auto t1 = std::chrono::high_resolution_clock::now();
       for (unsigned long long i = 0; i < warm_up_elements; ++i) {
@@ -1016,6 +1228,7 @@ ltqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
           std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
               .count();
       local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     }
 
     double enqueues = 0;
@@ -1063,10 +1276,12 @@ ltqueue_single_one_queue_microbenchmark(unsigned long long number_of_elements,
   }
 
   report_single_one_queue(
-      "LTQueue", number_of_elements, iterations, total_microseconds,
+      Fanout == 2 ? "LTQueue"
+                  : "LTQueue (fanout " + std::to_string(Fanout) + ")",
+      number_of_elements, iterations, total_microseconds,
       total_dequeues, total_successful_dequeues, total_dequeues_microseconds,
       total_enqueues, total_successful_enqueues, total_enqueues_microseconds,
-      total_enqueues_latency_microseconds);
+      total_enqueues_latency_microseconds, total_stats);
 }
 
 inline void ltqueue_node_single_one_queue_microbenchmark(
@@ -1085,6 +1300,7 @@ inline void ltqueue_node_single_one_queue_microbenchmark(
   double total_enqueues_microseconds = 0;
   double total_dequeues_microseconds = 0;
   double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
 
   for (int i = 0; i < iterations; ++i) {
     double local_enqueues = 0;
@@ -1113,6 +1329,7 @@ inline void ltqueue_node_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
               .count();
       local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     } else {
       LTNodeQueue<int> queue(elements_per_queue, 0, MPI_COMM_WORLD);
       int warm_up_elements = 5;
@@ -1144,6 +1361,7 @@ inline void ltqueue_node_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
               .count();
       local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     }
 
     double enqueues = 0;
@@ -1194,7 +1412,7 @@ inline void ltqueue_node_single_one_queue_microbenchmark(
       "LTQueue Node", number_of_elements, iterations, total_microseconds,
       total_dequeues, total_successful_dequeues, total_dequeues_microseconds,
       total_enqueues, total_successful_enqueues, total_enqueues_microseconds,
-      total_enqueues_latency_microseconds);
+      total_enqueues_latency_microseconds, total_stats);
 }
 
 inline void hosted_slotqueue_single_one_queue_microbenchmark(
@@ -1213,6 +1431,7 @@ inline void hosted_slotqueue_single_one_queue_microbenchmark(
   double total_enqueues_microseconds = 0;
   double total_dequeues_microseconds = 0;
   double total_enqueues_latency_microseconds = 0;
+  queue_stats_t total_stats;
 
   for (int i = 0; i < iterations; ++i) {
     double local_enqueues = 0;
@@ -1241,6 +1460,7 @@ inline void hosted_slotqueue_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1)
               .count();
       local_dequeues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     } else {
       HostedSlotQueue<int> queue(elements_per_queue, 0, MPI_COMM_WORLD);
       int warm_up_elements = 5;
@@ -1272,6 +1492,7 @@ inline void hosted_slotqueue_single_one_queue_microbenchmark(
           std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3)
               .count();
       local_enqueues_microseconds = local_microseconds;
+      total_stats += queue.stats();
     }
 
     double enqueues = 0;
@@ -1322,5 +1543,5 @@ inline void hosted_slotqueue_single_one_queue_microbenchmark(
       "Hosted Slotqueue", number_of_elements, iterations, total_microseconds,
       total_dequeues, total_successful_dequeues, total_dequeues_microseconds,
       total_enqueues, total_successful_enqueues, total_enqueues_microseconds,
-      total_enqueues_latency_microseconds);
+      total_enqueues_latency_microseconds, total_stats);
 }
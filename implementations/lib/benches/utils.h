@@ -397,3 +397,118 @@ inline void report_RMO_latency_all_to_all(unsigned int ops = 1000) {
 
   MPI_Info_free(&info);
 }
+
+// Compares the byte-wise (MPI_CHAR) accumulates comm.hpp used to issue with
+// the typed ones it issues now, for a 64-bit word and a 16-byte element.
+inline void report_RMO_latency_accumulate_datatypes(unsigned int ops = 1000) {
+  struct pair_t {
+    uint64_t first;
+    uint64_t second;
+  };
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  int size;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "same_disp_unit", "true");
+  MPI_Info_set(info, "accumulate_ordering", "none");
+  MPI_Info_set(info, "which_accumulate_ops", "replace,no_op");
+
+  MPI_Win win;
+  pair_t *ptr;
+  MPI_Win_allocate(rank != 0 ? 0 : sizeof(pair_t), sizeof(pair_t), info,
+                   MPI_COMM_WORLD, &ptr, &win);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+  if (rank == 0) {
+    *ptr = {0, 0};
+  }
+  MPI_Win_flush_all(win);
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  enum OpType { BYTE_READ, TYPED_READ, BYTE_WRITE, TYPED_WRITE };
+  constexpr int OP_TYPES = 4;
+  double word_microseconds[OP_TYPES] = {};
+  double pair_microseconds[OP_TYPES] = {};
+
+  if (rank == size - 1) {
+    for (unsigned int i = 0; i < ops; ++i) {
+      for (int op = 0; op < OP_TYPES; ++op) {
+        uint64_t word = i;
+        pair_t pair = {i, i};
+        auto t_0 = std::chrono::high_resolution_clock::now();
+        switch (op) {
+        case BYTE_READ:
+          MPI_Get_accumulate(NULL, 0, MPI_INT, &word, sizeof(word), MPI_CHAR,
+                             0, 0, sizeof(word), MPI_CHAR, MPI_NO_OP, win);
+          MPI_Win_flush(0, win);
+          break;
+        case TYPED_READ:
+          aread_sync(&word, 0, 0, win);
+          break;
+        case BYTE_WRITE:
+          MPI_Accumulate(&word, sizeof(word), MPI_CHAR, 0, 0, sizeof(word),
+                         MPI_CHAR, MPI_REPLACE, win);
+          MPI_Win_flush(0, win);
+          break;
+        case TYPED_WRITE:
+          awrite_sync(&word, 0, 0, win);
+          break;
+        }
+        auto t_1 = std::chrono::high_resolution_clock::now();
+        switch (op) {
+        case BYTE_READ:
+          MPI_Get_accumulate(NULL, 0, MPI_INT, &pair, sizeof(pair), MPI_CHAR,
+                             0, 0, sizeof(pair), MPI_CHAR, MPI_NO_OP, win);
+          MPI_Win_flush(0, win);
+          break;
+        case TYPED_READ:
+          aread_sync(&pair, 0, 0, win);
+          break;
+        case BYTE_WRITE:
+          MPI_Accumulate(&pair, sizeof(pair), MPI_CHAR, 0, 0, sizeof(pair),
+                         MPI_CHAR, MPI_REPLACE, win);
+          MPI_Win_flush(0, win);
+          break;
+        case TYPED_WRITE:
+          awrite_sync(&pair, 0, 0, win);
+          break;
+        }
+        auto t_2 = std::chrono::high_resolution_clock::now();
+        // Sub-microsecond resolution, the typed path can be that fast
+        word_microseconds[op] +=
+            std::chrono::duration<double, std::micro>(t_1 - t_0).count();
+        pair_microseconds[op] +=
+            std::chrono::duration<double, std::micro>(t_2 - t_1).count();
+      }
+    }
+  }
+
+  MPI_Win_unlock_all(win);
+  MPI_Win_free(&win);
+
+  MPI_Allreduce(MPI_IN_PLACE, word_microseconds, OP_TYPES, MPI_DOUBLE, MPI_MAX,
+                MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, pair_microseconds, OP_TYPES, MPI_DOUBLE, MPI_MAX,
+                MPI_COMM_WORLD);
+
+  if (rank == 0) {
+    printf("---- RMO latency - accumulate datatypes ----\n");
+    printf("8-byte atomic read latency: %g us (MPI_CHAR), %g us (typed)\n",
+           word_microseconds[BYTE_READ] / ops,
+           word_microseconds[TYPED_READ] / ops);
+    printf("8-byte atomic write latency: %g us (MPI_CHAR), %g us (typed)\n",
+           word_microseconds[BYTE_WRITE] / ops,
+           word_microseconds[TYPED_WRITE] / ops);
+    printf("16-byte atomic read latency: %g us (MPI_CHAR), %g us (typed)\n",
+           pair_microseconds[BYTE_READ] / ops,
+           pair_microseconds[TYPED_READ] / ops);
+    printf("16-byte atomic write latency: %g us (MPI_CHAR), %g us (typed)\n",
+           pair_microseconds[BYTE_WRITE] / ops,
+           pair_microseconds[TYPED_WRITE] / ops);
+  }
+
+  MPI_Info_free(&info);
+}
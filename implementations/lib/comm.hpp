@@ -1,5 +1,7 @@
 #pragma once
 
+#include "node_local.hpp"
+#include "stats.hpp"
 #include <cstdint>
 #include <mpi.h>
 #include <type_traits>
@@ -7,315 +9,513 @@
 #include <caliper/cali.h>
 #endif
 
+// Accumulates move T as a run of the widest unsigned integer words dividing
+// sizeof(T) rather than as bytes, so the MPI library can map them to native
+// (NIC) atomics instead of emulating them in software.
+template <typename T> inline MPI_Datatype accumulate_type() {
+  if constexpr (sizeof(T) % 8 == 0) {
+    return MPI_UINT64_T;
+  } else if constexpr (sizeof(T) % 4 == 0) {
+    return MPI_UINT32_T;
+  } else if constexpr (sizeof(T) % 2 == 0) {
+    return MPI_UINT16_T;
+  } else {
+    return MPI_UINT8_T;
+  }
+}
+
+template <typename T> constexpr int accumulate_count(int size) {
+  if constexpr (sizeof(T) % 8 == 0) {
+    return size * (sizeof(T) / 8);
+  } else if constexpr (sizeof(T) % 4 == 0) {
+    return size * (sizeof(T) / 4);
+  } else if constexpr (sizeof(T) % 2 == 0) {
+    return size * (sizeof(T) / 2);
+  } else {
+    return size * sizeof(T);
+  }
+}
+
 // put
 template <typename T>
-inline void write_sync(const T *src, int disp, unsigned int target_rank,
+inline void write_sync(const T *src, MPI_Aint disp, unsigned int target_rank,
                        const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_store(src, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T));
   MPI_Put(src, sizeof(T), MPI_CHAR, target_rank, disp, sizeof(T), MPI_CHAR,
           win);
   MPI_Win_flush(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void batch_write_sync(const T *src, int size, int disp,
+inline void batch_write_sync(const T *src, int size, MPI_Aint disp,
                              unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_store(src, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T) * size);
   MPI_Put(src, sizeof(T) * size, MPI_CHAR, target_rank, disp, size * sizeof(T),
           MPI_CHAR, win);
   MPI_Win_flush(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void write_async(const T *src, int disp, unsigned int target_rank,
+inline void write_async(const T *src, MPI_Aint disp, unsigned int target_rank,
                         const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_store(src, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T));
   MPI_Put(src, sizeof(T), MPI_CHAR, target_rank, disp, sizeof(T), MPI_CHAR,
           win);
 }
 
 template <typename T>
-inline void batch_write_async(const T *src, int size, int disp,
+inline void batch_write_async(const T *src, int size, MPI_Aint disp,
                               unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_store(src, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T) * size);
   MPI_Put(src, sizeof(T) * size, MPI_CHAR, target_rank, disp, size * sizeof(T),
           MPI_CHAR, win);
 }
 
 template <typename T>
-inline void write_block(const T *src, int disp, unsigned int target_rank,
+inline void write_block(const T *src, MPI_Aint disp, unsigned int target_rank,
                         const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_store(src, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T));
   MPI_Put(src, sizeof(T), MPI_CHAR, target_rank, disp, sizeof(T), MPI_CHAR,
           win);
   MPI_Win_flush_local(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void batch_write_block(const T *src, int size, int disp,
+inline void batch_write_block(const T *src, int size, MPI_Aint disp,
                               unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_store(src, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T) * size);
   MPI_Put(src, sizeof(T) * size, MPI_CHAR, target_rank, disp, size * sizeof(T),
           MPI_CHAR, win);
   MPI_Win_flush_local(target_rank, win);
+  stats_count_flush();
 }
 
 // get
 template <typename T>
-inline void read_sync(T *dst, int disp, unsigned int target_rank,
+inline void read_sync(T *dst, MPI_Aint disp, unsigned int target_rank,
                       const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_load(dst, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T));
   MPI_Get(dst, sizeof(T), MPI_CHAR, target_rank, disp, sizeof(T), MPI_CHAR,
           win);
   MPI_Win_flush(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void batch_read_sync(T *dst, int size, int disp,
+inline void batch_read_sync(T *dst, int size, MPI_Aint disp,
                             unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_load(dst, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T) * size);
   MPI_Get(dst, sizeof(T) * size, MPI_CHAR, target_rank, disp, size * sizeof(T),
           MPI_CHAR, win);
   MPI_Win_flush(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void read_async(T *dst, int disp, unsigned int target_rank,
+inline void read_async(T *dst, MPI_Aint disp, unsigned int target_rank,
                        const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_load(dst, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T));
   MPI_Get(dst, sizeof(T), MPI_CHAR, target_rank, disp, sizeof(T), MPI_CHAR,
           win);
 }
 
 template <typename T>
-inline void batch_read_async(T *dst, int size, int disp,
+inline void batch_read_async(T *dst, int size, MPI_Aint disp,
                              unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_load(dst, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T) * size);
   MPI_Get(dst, sizeof(T) * size, MPI_CHAR, target_rank, disp, size * sizeof(T),
           MPI_CHAR, win);
 }
 
 template <typename T>
-inline void read_block(T *dst, int disp, unsigned int target_rank,
+inline void read_block(T *dst, MPI_Aint disp, unsigned int target_rank,
                        const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_load(dst, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T));
   MPI_Get(dst, sizeof(T), MPI_CHAR, target_rank, disp, sizeof(T), MPI_CHAR,
           win);
   MPI_Win_flush_local(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void batch_read_block(T *dst, int size, int disp,
+inline void batch_read_block(T *dst, int size, MPI_Aint disp,
                              unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_load(dst, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T) * size);
   MPI_Get(dst, sizeof(T) * size, MPI_CHAR, target_rank, disp, size * sizeof(T),
           MPI_CHAR, win);
   MPI_Win_flush_local(target_rank, win);
+  stats_count_flush();
 }
 
 // accumulate put
 
 template <typename T>
-inline void awrite_sync(const T *src, int disp, unsigned int target_rank,
+inline void awrite_sync(const T *src, MPI_Aint disp, unsigned int target_rank,
                         const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Accumulate(src, sizeof(T), MPI_CHAR, target_rank, disp, sizeof(T),
-                 MPI_CHAR, MPI_REPLACE, win);
+  if (node_local_store(src, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T));
+  MPI_Accumulate(src, accumulate_count<T>(1), accumulate_type<T>(), target_rank,
+                 disp, accumulate_count<T>(1), accumulate_type<T>(),
+                 MPI_REPLACE, win);
   MPI_Win_flush(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void batch_awrite_sync(const T *src, int size, int disp,
+inline void batch_awrite_sync(const T *src, int size, MPI_Aint disp,
                               unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Accumulate(src, sizeof(T) * size, MPI_CHAR, target_rank, disp,
-                 sizeof(T) * size, MPI_CHAR, MPI_REPLACE, win);
+  if (node_local_store(src, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T) * size);
+  MPI_Accumulate(src, accumulate_count<T>(size), accumulate_type<T>(),
+                 target_rank, disp, accumulate_count<T>(size),
+                 accumulate_type<T>(), MPI_REPLACE, win);
   MPI_Win_flush(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void awrite_async(const T *src, int disp, unsigned int target_rank,
+inline void awrite_async(const T *src, MPI_Aint disp, unsigned int target_rank,
                          const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Accumulate(src, sizeof(T), MPI_CHAR, target_rank, disp, sizeof(T),
-                 MPI_CHAR, MPI_REPLACE, win);
+  if (node_local_store(src, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T));
+  MPI_Accumulate(src, accumulate_count<T>(1), accumulate_type<T>(), target_rank,
+                 disp, accumulate_count<T>(1), accumulate_type<T>(),
+                 MPI_REPLACE, win);
 }
 
 template <typename T>
-inline void batch_awrite_async(const T *src, int size, int disp,
+inline void batch_awrite_async(const T *src, int size, MPI_Aint disp,
                                unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Accumulate(src, sizeof(T) * size, MPI_CHAR, target_rank, disp,
-                 sizeof(T) * size, MPI_CHAR, MPI_REPLACE, win);
-  MPI_Win_flush(target_rank, win);
+  if (node_local_store(src, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T) * size);
+  MPI_Accumulate(src, accumulate_count<T>(size), accumulate_type<T>(),
+                 target_rank, disp, accumulate_count<T>(size),
+                 accumulate_type<T>(), MPI_REPLACE, win);
 }
 
 template <typename T>
-inline void awrite_block(const T *src, int disp, unsigned int target_rank,
+inline void awrite_block(const T *src, MPI_Aint disp, unsigned int target_rank,
                          const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Accumulate(src, sizeof(T), MPI_CHAR, target_rank, disp, sizeof(T),
-                 MPI_CHAR, MPI_REPLACE, win);
+  if (node_local_store(src, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T));
+  MPI_Accumulate(src, accumulate_count<T>(1), accumulate_type<T>(), target_rank,
+                 disp, accumulate_count<T>(1), accumulate_type<T>(),
+                 MPI_REPLACE, win);
   MPI_Win_flush_local(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void batch_awrite_block(const T *src, int size, int disp,
+inline void batch_awrite_block(const T *src, int size, MPI_Aint disp,
                                unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Accumulate(src, sizeof(T) * size, MPI_CHAR, target_rank, disp,
-                 sizeof(T) * size, MPI_CHAR, MPI_REPLACE, win);
+  if (node_local_store(src, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_put(sizeof(T) * size);
+  MPI_Accumulate(src, accumulate_count<T>(size), accumulate_type<T>(),
+                 target_rank, disp, accumulate_count<T>(size),
+                 accumulate_type<T>(), MPI_REPLACE, win);
   MPI_Win_flush_local(target_rank, win);
+  stats_count_flush();
 }
 
 // accumulate get
 template <typename T>
-inline void aread_sync(T *dst, int disp, unsigned int target_rank,
+inline void aread_sync(T *dst, MPI_Aint disp, unsigned int target_rank,
                        const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, sizeof(T), MPI_CHAR, target_rank,
-                     disp, sizeof(T), MPI_CHAR, MPI_NO_OP, win);
+  if (node_local_load(dst, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T));
+  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, accumulate_count<T>(1),
+                     accumulate_type<T>(), target_rank, disp,
+                     accumulate_count<T>(1), accumulate_type<T>(), MPI_NO_OP,
+                     win);
   MPI_Win_flush(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void batch_aread_sync(T *dst, int size, int disp,
+inline void batch_aread_sync(T *dst, int size, MPI_Aint disp,
                              unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Request request;
-  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, sizeof(T) * size, MPI_CHAR,
-                     target_rank, disp, size * sizeof(T), MPI_CHAR, MPI_NO_OP,
-                     win, &request);
-  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  if (node_local_load(dst, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T) * size);
+  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, accumulate_count<T>(size),
+                     accumulate_type<T>(), target_rank, disp,
+                     accumulate_count<T>(size), accumulate_type<T>(), MPI_NO_OP,
+                     win);
+  MPI_Win_flush(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void aread_async(T *dst, int disp, unsigned int target_rank,
+inline void aread_async(T *dst, MPI_Aint disp, unsigned int target_rank,
                         const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, sizeof(T), MPI_CHAR, target_rank,
-                     disp, sizeof(T), MPI_CHAR, MPI_NO_OP, win);
+  if (node_local_load(dst, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T));
+  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, accumulate_count<T>(1),
+                     accumulate_type<T>(), target_rank, disp,
+                     accumulate_count<T>(1), accumulate_type<T>(), MPI_NO_OP,
+                     win);
 }
 
 template <typename T>
-inline void batch_aread_async(T *dst, int size, int disp,
+inline void batch_aread_async(T *dst, int size, MPI_Aint disp,
                               unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, sizeof(T) * size, MPI_CHAR,
-                     target_rank, disp, sizeof(T) * size, MPI_CHAR, MPI_NO_OP,
+  if (node_local_load(dst, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T) * size);
+  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, accumulate_count<T>(size),
+                     accumulate_type<T>(), target_rank, disp,
+                     accumulate_count<T>(size), accumulate_type<T>(), MPI_NO_OP,
                      win);
 }
 
 template <typename T>
-inline void aread_block(T *dst, int disp, unsigned int target_rank,
+inline void aread_block(T *dst, MPI_Aint disp, unsigned int target_rank,
                         const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, sizeof(T), MPI_CHAR, target_rank,
-                     disp, sizeof(T), MPI_CHAR, MPI_NO_OP, win);
+  if (node_local_load(dst, 1, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T));
+  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, accumulate_count<T>(1),
+                     accumulate_type<T>(), target_rank, disp,
+                     accumulate_count<T>(1), accumulate_type<T>(), MPI_NO_OP,
+                     win);
   MPI_Win_flush_local(target_rank, win);
+  stats_count_flush();
 }
 
 template <typename T>
-inline void batch_aread_block(T *dst, int size, int disp,
+inline void batch_aread_block(T *dst, int size, MPI_Aint disp,
                               unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
-  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, sizeof(T) * size, MPI_CHAR,
-                     target_rank, disp, sizeof(T) * size, MPI_CHAR, MPI_NO_OP,
+  if (node_local_load(dst, size, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_get(sizeof(T) * size);
+  MPI_Get_accumulate(NULL, 0, MPI_INT, dst, accumulate_count<T>(size),
+                     accumulate_type<T>(), target_rank, disp,
+                     accumulate_count<T>(size), accumulate_type<T>(), MPI_NO_OP,
                      win);
   MPI_Win_flush_local(target_rank, win);
+  stats_count_flush();
 }
 
 // fetch-and-get
+// `increment` must stay valid until the operation is flushed.
 template <typename T>
-inline void fetch_and_add_sync(T *dst, uint64_t increment, int disp,
-                               unsigned int target_rank, const MPI_Win &win) {
+inline void fetch_and_add_async(T *dst, const T *increment, MPI_Aint disp,
+                                unsigned int target_rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_fetch_and_add(dst, increment, disp, target_rank, win)) {
+    return;
+  }
+  stats_count_fetch_and_add(sizeof(T));
   if constexpr (std::is_same_v<T, int64_t>) {
-    uint64_t inc = increment;
-    MPI_Fetch_and_op(&inc, dst, MPI_INT64_T, target_rank, disp, MPI_SUM, win);
-    MPI_Win_flush(target_rank, win);
+    MPI_Fetch_and_op(increment, dst, MPI_INT64_T, target_rank, disp, MPI_SUM,
+                     win);
   } else if constexpr (sizeof(T) == 8) {
-    uint64_t inc = increment;
-    MPI_Fetch_and_op(&inc, dst, MPI_UINT64_T, target_rank, disp, MPI_SUM, win);
-    MPI_Win_flush(target_rank, win);
+    MPI_Fetch_and_op(increment, dst, MPI_UINT64_T, target_rank, disp, MPI_SUM,
+                     win);
   } else if constexpr (std::is_same_v<T, int32_t>) {
-    uint64_t inc = increment;
-    MPI_Fetch_and_op(&inc, dst, MPI_INT32_T, target_rank, disp, MPI_SUM, win);
-    MPI_Win_flush(target_rank, win);
+    MPI_Fetch_and_op(increment, dst, MPI_INT32_T, target_rank, disp, MPI_SUM,
+                     win);
   } else if constexpr (sizeof(T) == 4) {
-    uint32_t inc = increment;
-    MPI_Fetch_and_op(&inc, dst, MPI_UINT32_T, target_rank, disp, MPI_SUM, win);
-    MPI_Win_flush(target_rank, win);
+    MPI_Fetch_and_op(increment, dst, MPI_UINT32_T, target_rank, disp, MPI_SUM,
+                     win);
   } else if constexpr (std::is_same_v<T, int16_t>) {
-    uint64_t inc = increment;
-    MPI_Fetch_and_op(&inc, dst, MPI_INT16_T, target_rank, disp, MPI_SUM, win);
-    MPI_Win_flush(target_rank, win);
+    MPI_Fetch_and_op(increment, dst, MPI_INT16_T, target_rank, disp, MPI_SUM,
+                     win);
   } else if constexpr (sizeof(T) == 2) {
-    uint16_t inc = increment;
-    MPI_Fetch_and_op(&inc, dst, MPI_UINT16_T, target_rank, disp, MPI_SUM, win);
-    MPI_Win_flush(target_rank, win);
+    MPI_Fetch_and_op(increment, dst, MPI_UINT16_T, target_rank, disp, MPI_SUM,
+                     win);
   } else if constexpr (std::is_same_v<T, int8_t>) {
-    uint64_t inc = increment;
-    MPI_Fetch_and_op(&inc, dst, MPI_INT8_T, target_rank, disp, MPI_SUM, win);
-    MPI_Win_flush(target_rank, win);
+    MPI_Fetch_and_op(increment, dst, MPI_INT8_T, target_rank, disp, MPI_SUM,
+                     win);
   } else if constexpr (std::is_same_v<T, int8_t>) {
-    uint64_t inc = increment;
-    MPI_Fetch_and_op(&inc, dst, MPI_C_BOOL, target_rank, disp, MPI_SUM, win);
-    MPI_Win_flush(target_rank, win);
+    MPI_Fetch_and_op(increment, dst, MPI_C_BOOL, target_rank, disp, MPI_SUM,
+                     win);
   } else if constexpr (sizeof(T) == 1) {
-    uint8_t inc = increment;
-    MPI_Fetch_and_op(&inc, dst, MPI_UINT8_T, target_rank, disp, MPI_SUM, win);
-    MPI_Win_flush(target_rank, win);
+    MPI_Fetch_and_op(increment, dst, MPI_UINT8_T, target_rank, disp, MPI_SUM,
+                     win);
+  } else {
+    static_assert(false, "Invalid template type");
+  }
+}
+
+template <typename T>
+inline void fetch_and_add_sync(T *dst, uint64_t increment, MPI_Aint disp,
+                               unsigned int target_rank, const MPI_Win &win) {
+#ifdef PROFILE
+  CALI_CXX_MARK_FUNCTION;
+#endif
+  const T inc = increment;
+  if (node_local_fetch_and_add(dst, &inc, disp, target_rank, win)) {
+    return;
+  }
+  fetch_and_add_async(dst, &inc, disp, target_rank, win);
+  MPI_Win_flush(target_rank, win);
+  stats_count_flush();
+}
+
+// Request-based fetch-and-add: `increment` must stay valid until `request`
+// completes.
+template <typename T>
+inline void fetch_and_add_request(T *dst, const T *increment, MPI_Aint disp,
+                                  unsigned int target_rank, const MPI_Win &win,
+                                  MPI_Request *request) {
+#ifdef PROFILE
+  CALI_CXX_MARK_FUNCTION;
+#endif
+  if (node_local_fetch_and_add(dst, increment, disp, target_rank, win)) {
+    *request = MPI_REQUEST_NULL;
+    return;
+  }
+  stats_count_fetch_and_add(sizeof(T));
+  if constexpr (std::is_same_v<T, int64_t>) {
+    MPI_Rget_accumulate(increment, 1, MPI_INT64_T, dst, 1, MPI_INT64_T,
+                        target_rank, disp, 1, MPI_INT64_T, MPI_SUM, win,
+                        request);
+  } else if constexpr (sizeof(T) == 8) {
+    MPI_Rget_accumulate(increment, 1, MPI_UINT64_T, dst, 1, MPI_UINT64_T,
+                        target_rank, disp, 1, MPI_UINT64_T, MPI_SUM, win,
+                        request);
+  } else if constexpr (std::is_same_v<T, int32_t>) {
+    MPI_Rget_accumulate(increment, 1, MPI_INT32_T, dst, 1, MPI_INT32_T,
+                        target_rank, disp, 1, MPI_INT32_T, MPI_SUM, win,
+                        request);
+  } else if constexpr (sizeof(T) == 4) {
+    MPI_Rget_accumulate(increment, 1, MPI_UINT32_T, dst, 1, MPI_UINT32_T,
+                        target_rank, disp, 1, MPI_UINT32_T, MPI_SUM, win,
+                        request);
   } else {
     static_assert(false, "Invalid template type");
   }
@@ -323,12 +523,17 @@ inline void fetch_and_add_sync(T *dst, uint64_t increment, int disp,
 
 // compare-and-swap
 template <typename T>
-inline void compare_and_swap_sync(const T *old_val, const T *new_val, T *result,
-                                  int disp, unsigned int target_rank,
-                                  const MPI_Win &win) {
+inline void compare_and_swap_async(const T *old_val, const T *new_val,
+                                   T *result, MPI_Aint disp,
+                                   unsigned int target_rank,
+                                   const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_compare_and_swap(old_val, new_val, result, disp, target_rank,
+                                  win)) {
+    return;
+  }
 
   MPI_Datatype type;
   if constexpr (std::is_same_v<T, int64_t>) {
@@ -353,8 +558,26 @@ inline void compare_and_swap_sync(const T *old_val, const T *new_val, T *result,
     static_assert(false, "Invalid template type");
   }
 
+  stats_count_compare_and_swap(sizeof(T));
   MPI_Compare_and_swap(new_val, old_val, result, type, target_rank, disp, win);
+}
+
+template <typename T>
+inline void compare_and_swap_sync(const T *old_val, const T *new_val, T *result,
+                                  MPI_Aint disp, unsigned int target_rank,
+                                  const MPI_Win &win) {
+#ifdef PROFILE
+  CALI_CXX_MARK_FUNCTION;
+#endif
+  if (node_local_compare_and_swap(old_val, new_val, result, disp, target_rank,
+                                  win)) {
+    stats_count_cas_result(old_val, result);
+    return;
+  }
+  compare_and_swap_async(old_val, new_val, result, disp, target_rank, win);
   MPI_Win_flush(target_rank, win);
+  stats_count_flush();
+  stats_count_cas_result(old_val, result);
 }
 
 // flush
@@ -362,12 +585,168 @@ inline void flush(unsigned int rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_target(rank, win)) {
+    return;
+  }
   MPI_Win_flush(rank, win);
+  stats_count_flush();
 }
 
 inline void flush_local(unsigned int rank, const MPI_Win &win) {
 #ifdef PROFILE
   CALI_CXX_MARK_FUNCTION;
 #endif
+  if (node_local_target(rank, win)) {
+    return;
+  }
   MPI_Win_flush_local(rank, win);
+  stats_count_flush();
+}
+
+// Whether `win` follows the unified memory model, where the public and
+// private copies of a rank's window are the same memory: a rank may then
+// update its own part with plain stores and make them visible to RMA accesses
+// with MPI_Win_sync, instead of issuing RMA operations to itself.
+inline bool win_unified(const MPI_Win &win) {
+  int *model;
+  int flag;
+  MPI_Win_get_attr(win, MPI_WIN_MODEL, &model, &flag);
+  return flag && *model == MPI_WIN_UNIFIED;
 }
+
+// Coalesces independent RMA operations: every operation is issued right away
+// without a flush, and each distinct (window, target) pair is flushed once by
+// flush() or when the epoch goes out of scope. Results and source buffers
+// follow the *_async rules until then.
+class RmaEpoch {
+private:
+  constexpr static int MAX_TARGETS = 8;
+
+  MPI_Win _wins[MAX_TARGETS];
+  unsigned int _ranks[MAX_TARGETS];
+  int _targets_count = 0;
+
+  void _track(unsigned int target_rank, const MPI_Win &win) {
+    for (int i = 0; i < this->_targets_count; ++i) {
+      if (this->_ranks[i] == target_rank && this->_wins[i] == win) {
+        return;
+      }
+    }
+    if (this->_targets_count == MAX_TARGETS) {
+      this->flush();
+    }
+    this->_wins[this->_targets_count] = win;
+    this->_ranks[this->_targets_count] = target_rank;
+    ++this->_targets_count;
+  }
+
+public:
+  RmaEpoch() = default;
+  RmaEpoch(const RmaEpoch &) = delete;
+  RmaEpoch &operator=(const RmaEpoch &) = delete;
+
+  ~RmaEpoch() { this->flush(); }
+
+  template <typename T>
+  void read(T *dst, MPI_Aint disp, unsigned int target_rank,
+            const MPI_Win &win) {
+    if (!node_local_load(dst, 1, disp, target_rank, win)) {
+      read_async(dst, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  template <typename T>
+  void batch_read(T *dst, int size, MPI_Aint disp, unsigned int target_rank,
+                  const MPI_Win &win) {
+    if (!node_local_load(dst, size, disp, target_rank, win)) {
+      batch_read_async(dst, size, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  template <typename T>
+  void write(const T *src, MPI_Aint disp, unsigned int target_rank,
+             const MPI_Win &win) {
+    if (!node_local_store(src, 1, disp, target_rank, win)) {
+      write_async(src, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  template <typename T>
+  void batch_write(const T *src, int size, MPI_Aint disp,
+                   unsigned int target_rank, const MPI_Win &win) {
+    if (!node_local_store(src, size, disp, target_rank, win)) {
+      batch_write_async(src, size, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  template <typename T>
+  void aread(T *dst, MPI_Aint disp, unsigned int target_rank,
+             const MPI_Win &win) {
+    if (!node_local_load(dst, 1, disp, target_rank, win)) {
+      aread_async(dst, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  template <typename T>
+  void batch_aread(T *dst, int size, MPI_Aint disp, unsigned int target_rank,
+                   const MPI_Win &win) {
+    if (!node_local_load(dst, size, disp, target_rank, win)) {
+      batch_aread_async(dst, size, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  template <typename T>
+  void awrite(const T *src, MPI_Aint disp, unsigned int target_rank,
+              const MPI_Win &win) {
+    if (!node_local_store(src, 1, disp, target_rank, win)) {
+      awrite_async(src, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  template <typename T>
+  void batch_awrite(const T *src, int size, MPI_Aint disp,
+                    unsigned int target_rank, const MPI_Win &win) {
+    if (!node_local_store(src, size, disp, target_rank, win)) {
+      batch_awrite_async(src, size, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  template <typename T>
+  void fetch_and_add(T *dst, const T *increment, MPI_Aint disp,
+                     unsigned int target_rank, const MPI_Win &win) {
+    if (!node_local_fetch_and_add(dst, increment, disp, target_rank, win)) {
+      fetch_and_add_async(dst, increment, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  template <typename T>
+  void compare_and_swap(const T *old_val, const T *new_val, T *result,
+                        MPI_Aint disp, unsigned int target_rank,
+                        const MPI_Win &win) {
+    if (!node_local_compare_and_swap(old_val, new_val, result, disp,
+                                     target_rank, win)) {
+      compare_and_swap_async(old_val, new_val, result, disp, target_rank, win);
+      this->_track(target_rank, win);
+    }
+  }
+
+  void flush() {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    for (int i = 0; i < this->_targets_count; ++i) {
+      MPI_Win_flush(this->_ranks[i], this->_wins[i]);
+      stats_count_flush();
+    }
+    this->_targets_count = 0;
+  }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mpi.h>
+
+// Counter-free timestamp source: every rank reads its own steady clock,
+// corrected by an offset to rank 0's clock that is estimated at construction,
+// and packs it as (time << rank_bits) | rank. Values are unique and increase
+// per rank, and values from different ranks are ordered by time up to the
+// clock-skew bound. Takes the same constructor arguments as FaaCounter so it
+// can replace it as a queue's counter policy; the dequeuer rank and the lease
+// size are unused.
+class ClockCounter {
+private:
+  constexpr static int SYNC_ROUNDS = 16;
+  constexpr static int SYNC_TAG = 0;
+
+  int _self_rank;
+  int _rank_bits;
+  int64_t _offset = 0;
+  int64_t _epoch = 0;
+  // Largest error of any rank's offset to rank 0's clock.
+  int64_t _offset_error = 0;
+  MPI_Aint _last = -1;
+
+  static int64_t _now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Ping-pong with rank 0, keeping the sample with the smallest round trip;
+  // its half round trip bounds the error of the offset.
+  void _synchronize(MPI_Comm comm, int size) {
+    for (int rank = 1; rank < size; ++rank) {
+      if (this->_self_rank == 0) {
+        for (int i = 0; i < SYNC_ROUNDS; ++i) {
+          int64_t ping;
+          MPI_Recv(&ping, 1, MPI_INT64_T, rank, SYNC_TAG, comm,
+                   MPI_STATUS_IGNORE);
+          const int64_t now = _now();
+          MPI_Send(&now, 1, MPI_INT64_T, rank, SYNC_TAG, comm);
+        }
+      } else if (this->_self_rank == rank) {
+        int64_t best_round_trip = INT64_MAX;
+        for (int i = 0; i < SYNC_ROUNDS; ++i) {
+          const int64_t sent = _now();
+          MPI_Send(&sent, 1, MPI_INT64_T, 0, SYNC_TAG, comm);
+          int64_t reference;
+          MPI_Recv(&reference, 1, MPI_INT64_T, 0, SYNC_TAG, comm,
+                   MPI_STATUS_IGNORE);
+          const int64_t received = _now();
+          if (received - sent < best_round_trip) {
+            best_round_trip = received - sent;
+            this->_offset = reference - (sent + received) / 2;
+          }
+        }
+        this->_offset_error = best_round_trip / 2;
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &this->_offset_error, 1, MPI_INT64_T, MPI_MAX,
+                  comm);
+    if (this->_self_rank == 0) {
+      this->_epoch = _now();
+    }
+    MPI_Bcast(&this->_epoch, 1, MPI_INT64_T, 0, comm);
+  }
+
+public:
+  // The dequeuer rank and lease size are unused; they keep the constructor
+  // interchangeable with FaaCounter's.
+  ClockCounter([[maybe_unused]] MPI_Aint dequeuer_rank, MPI_Comm comm,
+               [[maybe_unused]] MPI_Aint lease_size = 1) {
+    int size;
+    MPI_Comm_rank(comm, &this->_self_rank);
+    MPI_Comm_size(comm, &size);
+    this->_rank_bits = 0;
+    while ((1 << this->_rank_bits) < size) {
+      ++this->_rank_bits;
+    }
+    // The ping-pong runs on a private duplicate, so that its messages cannot
+    // match other traffic on `comm`.
+    MPI_Comm sync_comm;
+    MPI_Comm_dup(comm, &sync_comm);
+    this->_synchronize(sync_comm, size);
+    MPI_Comm_free(&sync_comm);
+  }
+
+  // Timestamps keep increasing across a queue reset, so there is nothing to
+  // reinitialize.
+  void reset() {}
+
+  inline MPI_Aint get_and_increment() {
+    const int64_t time = _now() + this->_offset - this->_epoch;
+    MPI_Aint value =
+        ((MPI_Aint)std::max<int64_t>(time, 0) << this->_rank_bits) |
+        this->_self_rank;
+    if (value <= this->_last) {
+      value = this->_last + (1 << this->_rank_bits);
+    }
+    this->_last = value;
+    return value;
+  }
+
+  inline void get_and_increment_async(MPI_Aint *output, MPI_Request *request) {
+    *output = this->get_and_increment();
+    *request = MPI_REQUEST_NULL;
+  }
+
+  // Estimated bound, in nanoseconds, on how far the corrected clocks of any
+  // two ranks disagree right after construction: each is off rank 0's by at
+  // most the largest half round trip, so two are off each other by at most
+  // twice that. Clock drift since construction is not accounted for.
+  int64_t skew_bound() const { return 2 * this->_offset_error; }
+};
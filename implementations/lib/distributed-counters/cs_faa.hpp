@@ -1,112 +1,161 @@
 #pragma once
 
-#include "../sleep.hpp"
 #include "faa.hpp"
 #include <atomic>
 #include <cstdint>
 #include <mpi.h>
-
+#include <vector>
+
+// Node-level flat-combining counter. Every rank of a shared-memory node owns
+// a request slot; a rank posts how many values it wants, and whichever rank
+// takes the node's combiner lock collects all posted requests, reserves their
+// total with one remote FAA and hands every requester a distinct sub-range.
+// A rank that is not served within MAX_WAIT_US, a few remote FAA latencies,
+// withdraws its request and falls back to a direct FAA.
 class CsFaaCounter {
 private:
-  constexpr static uint64_t MAX_COUNT = ~((uint64_t)0);
+  constexpr static uint64_t NO_RESPONSE = ~((uint64_t)0);
+  constexpr static double MAX_WAIT_US = 50;
+
+  struct alignas(64) slot_t {
+    // Number of values requested, 0 when there is no pending request.
+    std::atomic<uint64_t> request;
+    std::atomic<uint64_t> response;
+  };
 
-  MPI_Aint *_counter_ptr = nullptr;
-  MPI_Win _counter_win;
+  struct alignas(64) lock_t {
+    std::atomic<uint64_t> held;
+  };
 
   MPI_Info _info = MPI_INFO_NULL;
-  MPI_Aint _host;
 
   MPI_Comm _sm_comm = MPI_COMM_NULL;
   int _sm_size;
+  int _sm_rank;
 
-  MPI_Win _start_counter_win = MPI_WIN_NULL;
-  std::atomic<uint64_t> *_start_counter_ptr = nullptr;
+  MPI_Win _slot_win = MPI_WIN_NULL;
+  slot_t *_self_slot_ptr = nullptr;
+  // Peer slots and the combiner lock, resolved once at construction.
+  std::vector<slot_t *> _peer_slot_ptrs;
 
-  MPI_Win _self_start_counter_win = MPI_WIN_NULL;
-  std::atomic<uint64_t> *_self_start_counter_ptr = nullptr;
-
-  MPI_Win _self_remote_counter_win = MPI_WIN_NULL;
-  std::atomic<uint64_t> *_self_remote_counter_ptr = nullptr;
+  MPI_Win _lock_win = MPI_WIN_NULL;
+  lock_t *_lock_ptr = nullptr;
 
   FaaCounter _base_counter;
 
+  // Requests taken by the current combine, one per peer.
+  std::vector<uint64_t> _requests;
+
+  static inline void _cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+  }
+
+  void _combine() {
+    uint64_t total = 0;
+    std::vector<uint64_t> &requests = this->_requests;
+    for (int i = 0; i < this->_sm_size; ++i) {
+      requests[i] = this->_peer_slot_ptrs[i]->request.exchange(0);
+      total += requests[i];
+    }
+    if (total == 0) {
+      return;
+    }
+    uint64_t next = this->_base_counter.get_and_increment(total);
+    for (int i = 0; i < this->_sm_size; ++i) {
+      if (requests[i] == 0) {
+        continue;
+      }
+      this->_peer_slot_ptrs[i]->response.store(next, std::memory_order_release);
+      next += requests[i];
+    }
+  }
+
+  bool _try_combine() {
+    if (this->_lock_ptr->held.load(std::memory_order_relaxed) != 0 ||
+        this->_lock_ptr->held.exchange(1, std::memory_order_acquire) != 0) {
+      return false;
+    }
+    this->_combine();
+    this->_lock_ptr->held.store(0, std::memory_order_release);
+    return true;
+  }
+
 public:
-  CsFaaCounter(MPI_Aint dequeuer_rank, MPI_Comm comm) : _base_counter{dequeuer_rank, comm} {
+  CsFaaCounter(MPI_Aint dequeuer_rank, MPI_Comm comm)
+      : _base_counter{dequeuer_rank, comm} {
     MPI_Info_create(&this->_info);
     MPI_Info_set(this->_info, "same_disp_unit", "true");
     MPI_Info_set(this->_info, "accumulate_ordering", "none");
     MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
                         &this->_sm_comm);
     MPI_Comm_size(this->_sm_comm, &this->_sm_size);
+    MPI_Comm_rank(this->_sm_comm, &this->_sm_rank);
+
+    MPI_Win_allocate_shared(sizeof(slot_t), sizeof(slot_t), this->_info,
+                            this->_sm_comm, &this->_self_slot_ptr,
+                            &this->_slot_win);
+    MPI_Win_allocate_shared(this->_sm_rank == 0 ? sizeof(lock_t) : 0,
+                            sizeof(lock_t), this->_info, this->_sm_comm,
+                            &this->_lock_ptr, &this->_lock_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_slot_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_lock_win);
+
+    this->_self_slot_ptr->request.store(0);
+    this->_self_slot_ptr->response.store(NO_RESPONSE);
+    MPI_Aint size;
+    int disp_unit;
+    if (this->_sm_rank == 0) {
+      this->_lock_ptr->held.store(0);
+    } else {
+      MPI_Win_shared_query(this->_lock_win, 0, &size, &disp_unit,
+                           &this->_lock_ptr);
+    }
+    this->_peer_slot_ptrs.resize(this->_sm_size);
+    this->_requests.resize(this->_sm_size);
+    for (int i = 0; i < this->_sm_size; ++i) {
+      MPI_Win_shared_query(this->_slot_win, i, &size, &disp_unit,
+                           &this->_peer_slot_ptrs[i]);
+    }
 
-    MPI_Win_allocate_shared(sizeof(std::atomic<uint64_t>),
-                            sizeof(std::atomic<uint64_t>), this->_info,
-                            this->_sm_comm, &this->_self_remote_counter_ptr,
-                            &this->_self_remote_counter_win);
-    MPI_Win_allocate_shared(sizeof(std::atomic<uint64_t>),
-                            sizeof(std::atomic<uint64_t>), this->_info,
-                            this->_sm_comm, &this->_start_counter_ptr,
-                            &this->_start_counter_win);
-    MPI_Win_allocate_shared(sizeof(std::atomic<uint64_t>),
-                            sizeof(std::atomic<uint64_t>), this->_info,
-                            this->_sm_comm, &this->_self_start_counter_ptr,
-                            &this->_self_start_counter_win);
-
-    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_self_remote_counter_win);
-    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_start_counter_win);
-    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_self_start_counter_win);
-    *this->_self_remote_counter_ptr = 0;
-    *this->_start_counter_ptr = 0;
-    *this->_self_start_counter_ptr = 0;
-
-    MPI_Win_flush_all(this->_self_remote_counter_win);
-    MPI_Win_flush_all(this->_start_counter_win);
-    MPI_Win_flush_all(this->_self_start_counter_win);
+    MPI_Win_sync(this->_slot_win);
+    MPI_Win_sync(this->_lock_win);
     MPI_Barrier(comm);
-    MPI_Win_flush_all(this->_self_remote_counter_win);
-    MPI_Win_flush_all(this->_start_counter_win);
-    MPI_Win_flush_all(this->_self_start_counter_win);
+    MPI_Win_sync(this->_slot_win);
+    MPI_Win_sync(this->_lock_win);
   }
 
   CsFaaCounter(const CsFaaCounter &) = delete;
   CsFaaCounter &operator=(const CsFaaCounter &) = delete;
 
   CsFaaCounter(CsFaaCounter &&other) noexcept
-      : _counter_ptr(other._counter_ptr), _counter_win(other._counter_win),
-        _info(other._info), _host(other._host), _sm_comm(other._sm_comm),
-        _sm_size(other._sm_size), _start_counter_win(other._start_counter_win),
-        _start_counter_ptr(other._start_counter_ptr),
-        _self_start_counter_win(other._self_start_counter_win),
-        _self_start_counter_ptr(other._self_start_counter_ptr),
-        _self_remote_counter_win(other._self_remote_counter_win),
-        _self_remote_counter_ptr(other._self_remote_counter_ptr),
-        _base_counter(std::move(other._base_counter)) {
-    other._counter_ptr = nullptr;
-    other._counter_win = MPI_WIN_NULL;
+      : _info(other._info), _sm_comm(other._sm_comm),
+        _sm_size(other._sm_size), _sm_rank(other._sm_rank),
+        _slot_win(other._slot_win), _self_slot_ptr(other._self_slot_ptr),
+        _peer_slot_ptrs(std::move(other._peer_slot_ptrs)),
+        _lock_win(other._lock_win), _lock_ptr(other._lock_ptr),
+        _base_counter(std::move(other._base_counter)),
+        _requests(std::move(other._requests)) {
     other._info = MPI_INFO_NULL;
-    other._host = 0;
     other._sm_comm = MPI_COMM_NULL;
     other._sm_size = 0;
-    other._start_counter_win = MPI_WIN_NULL;
-    other._start_counter_ptr = nullptr;
-    other._self_start_counter_win = MPI_WIN_NULL;
-    other._self_start_counter_ptr = nullptr;
-    other._self_remote_counter_win = MPI_WIN_NULL;
-    other._self_remote_counter_ptr = nullptr;
+    other._slot_win = MPI_WIN_NULL;
+    other._self_slot_ptr = nullptr;
+    other._lock_win = MPI_WIN_NULL;
+    other._lock_ptr = nullptr;
   }
 
   ~CsFaaCounter() {
-    if (_self_remote_counter_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_self_remote_counter_win);
-      MPI_Win_free(&this->_self_remote_counter_win);
-    }
-    if (_start_counter_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_start_counter_win);
-      MPI_Win_free(&this->_start_counter_win);
+    if (_slot_win != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(_slot_win);
+      MPI_Win_free(&this->_slot_win);
     }
-    if (_self_start_counter_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_self_start_counter_win);
-      MPI_Win_free(&this->_self_start_counter_win);
+    if (_lock_win != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(_lock_win);
+      MPI_Win_free(&this->_lock_win);
     }
     if (_sm_comm != MPI_COMM_NULL) {
       MPI_Comm_free(&this->_sm_comm);
@@ -116,44 +165,49 @@ public:
     }
   }
 
-  inline MPI_Aint get_and_increment() {
-    this->_self_remote_counter_ptr->store(MAX_COUNT);
-    MPI_Aint size = 1;
-    int disp_unit = sizeof(std::atomic<uint64_t>);
-    std::atomic<uint64_t> *shared_start_baseptr;
-    MPI_Win_shared_query(this->_start_counter_win, 0, &size, &disp_unit,
-                         &shared_start_baseptr);
-    MPI_Aint self_start = shared_start_baseptr->fetch_add(1);
-    this->_self_start_counter_ptr->store(self_start);
-
-    MPI_Aint self_counter = MAX_COUNT;
-    for (int i = 0; i < this->_sm_size; ++i) {
-      std::atomic<uint64_t> *start_baseptr;
-      MPI_Win_shared_query(this->_self_start_counter_win, i, &size, &disp_unit,
-                           &start_baseptr);
-      if (self_start < start_baseptr->load()) {
-        std::atomic<uint64_t> *self_baseptr;
-        MPI_Win_shared_query(this->_self_remote_counter_win, i, &size,
-                             &disp_unit, &self_baseptr);
-        MPI_Aint counter = self_baseptr->load();
-        if (counter == MAX_COUNT) {
-          for (int retries = 0; retries < 300; ++retries) {
-            spin(100);
-            MPI_Aint counter = self_baseptr->load();
-            if (counter != MAX_COUNT) {
-              self_counter = counter;
-              break;
-            }
-          }
-        } else {
-          self_counter = counter;
-        }
+  // Restarts the count at 0. It does not synchronize; the owning queue's
+  // reset() does.
+  void reset() {
+    this->_self_slot_ptr->request.store(0);
+    this->_self_slot_ptr->response.store(NO_RESPONSE);
+    if (this->_sm_rank == 0) {
+      this->_lock_ptr->held.store(0);
+    }
+    this->_base_counter.reset();
+  }
+
+  inline MPI_Aint get_and_increment() { return this->get_and_increment(1); }
+
+  // Reserves `n` consecutive values and returns the first one.
+  inline MPI_Aint get_and_increment(MPI_Aint n) {
+    slot_t *slot = this->_self_slot_ptr;
+    slot->response.store(NO_RESPONSE, std::memory_order_relaxed);
+    slot->request.store(n, std::memory_order_release);
+
+    const double start = MPI_Wtime();
+    do {
+      uint64_t response = slot->response.load(std::memory_order_acquire);
+      if (response != NO_RESPONSE) {
+        return response;
+      }
+      // A combiner releases the lock only after answering every request it
+      // took, so once we have combined our own request is answered.
+      if (this->_try_combine()) {
+        return slot->response.load(std::memory_order_acquire);
       }
+      _cpu_relax();
+    } while ((MPI_Wtime() - start) * 1e6 < MAX_WAIT_US);
+
+    // Withdraw; if a combiner took the request meanwhile, it is about to
+    // answer it.
+    if (slot->request.exchange(0) != 0) {
+      return this->_base_counter.get_and_increment(n);
     }
-    if (self_counter == MAX_COUNT) {
-      self_counter = this->_base_counter.get_and_increment();
+    uint64_t response;
+    while ((response = slot->response.load(std::memory_order_acquire)) ==
+           NO_RESPONSE) {
+      _cpu_relax();
     }
-    this->_self_remote_counter_ptr->store(self_counter);
-    return self_counter;
+    return response;
   }
 };
@@ -1,33 +1,43 @@
 #pragma once
 #include "../comm.hpp"
+#include "../queue_arena.hpp"
+#include "../window_layout.hpp"
 #include <mpi.h>
 
 class FaaCounter {
 private:
+  WindowLayout::Region<MPI_Aint> _counter_region;
   MPI_Aint *_counter_ptr = nullptr;
   MPI_Win _counter_win = MPI_WIN_NULL;
+  // False when the counter lives in a QueueArena's window.
+  bool _owns_win = true;
   MPI_Info _info = MPI_INFO_NULL;
   MPI_Aint _host;
+  constexpr static MPI_Aint INCREMENT = 1;
+
+  // Values reserved by the last range FAA and not handed out yet.
+  MPI_Aint _lease_size;
+  MPI_Aint _lease_next = 0;
+  MPI_Aint _lease_end = 0;
 
 public:
-  FaaCounter(MPI_Aint dequeuer_rank, MPI_Comm comm) {
+  FaaCounter(MPI_Aint dequeuer_rank, MPI_Comm comm, MPI_Aint lease_size = 1)
+      : _lease_size{lease_size} {
     MPI_Info_create(&this->_info);
     MPI_Info_set(this->_info, "same_disp_unit", "true");
     MPI_Info_set(this->_info, "accumulate_ordering", "none");
+    MPI_Info_set(this->_info, "which_accumulate_ops", "sum");
     int size;
     MPI_Comm_size(comm, &size);
     this->_host = (dequeuer_rank + 1) % size;
     int rank;
     MPI_Comm_rank(comm, &rank);
-    if (_host == rank) {
-      MPI_Win_allocate(sizeof(MPI_Aint), sizeof(MPI_Aint), this->_info, comm,
-                       &this->_counter_ptr, &this->_counter_win);
-    } else {
-      MPI_Win_allocate(0, sizeof(MPI_Aint), this->_info, comm,
-                       &this->_counter_ptr, &this->_counter_win);
-    }
+    WindowLayout layout;
+    this->_counter_region = layout.add<MPI_Aint>(1, this->_host == rank);
+    void *base = layout.allocate(this->_info, comm, &this->_counter_win);
     MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_counter_win);
     if (_host == rank) {
+      this->_counter_ptr = this->_counter_region.ptr(base);
       *this->_counter_ptr = 0;
     }
     MPI_Win_flush_all(this->_counter_win);
@@ -35,12 +45,41 @@ public:
     MPI_Win_flush_all(this->_counter_win);
   }
 
+  // Carves the counter from `arena`; see QueueArena for the protocol.
+  FaaCounter(MPI_Aint dequeuer_rank, QueueArena &arena,
+             MPI_Aint lease_size = 1)
+      : _counter_win{arena.win()}, _owns_win{false},
+        _lease_size{lease_size} {
+    int size;
+    MPI_Comm_size(arena.comm(), &size);
+    this->_host = (dequeuer_rank + 1) % size;
+    int rank;
+    MPI_Comm_rank(arena.comm(), &rank);
+    WindowLayout layout = arena.layout();
+    this->_counter_region = layout.add<MPI_Aint>(1, this->_host == rank);
+    void *base = arena.allocate(layout);
+    if (_host == rank) {
+      this->_counter_ptr = this->_counter_region.ptr(base);
+      *this->_counter_ptr = 0;
+    }
+  }
+
+  // Arena space one counter takes.
+  static MPI_Aint arena_size() {
+    WindowLayout layout;
+    layout.add<MPI_Aint>(1, true);
+    return QueueArena::footprint(layout);
+  }
+
   FaaCounter(const FaaCounter &) = delete;
   FaaCounter &operator=(const FaaCounter &) = delete;
 
   FaaCounter(FaaCounter &&other) noexcept
-      : _counter_ptr(other._counter_ptr), _counter_win(other._counter_win),
-        _info(other._info), _host(other._host) {
+      : _counter_region(other._counter_region),
+        _counter_ptr(other._counter_ptr), _counter_win(other._counter_win),
+        _owns_win(other._owns_win), _info(other._info), _host(other._host),
+        _lease_size(other._lease_size), _lease_next(other._lease_next),
+        _lease_end(other._lease_end) {
     other._counter_ptr = nullptr;
     other._counter_win = MPI_WIN_NULL;
     other._info = MPI_INFO_NULL;
@@ -48,18 +87,56 @@ public:
   }
 
   ~FaaCounter() {
-    if (_counter_win != MPI_WIN_NULL) {
+    if (_counter_win != MPI_WIN_NULL && _owns_win) {
       MPI_Win_unlock_all(this->_counter_win);
-      MPI_Win_free(&this->_counter_win);
+      win_free(&this->_counter_win);
     }
     if (_info != MPI_INFO_NULL) {
       MPI_Info_free(&this->_info);
     }
   }
 
+  // Restarts the count at 0, dropping any lease. It does not synchronize;
+  // the owning queue's reset() does.
+  void reset() {
+    if (this->_counter_ptr != nullptr) {
+      *this->_counter_ptr = 0;
+    }
+    this->_lease_next = 0;
+    this->_lease_end = 0;
+  }
+
+  // With a lease size K > 1, one remote FAA reserves K consecutive values
+  // that are then handed out locally.
   inline MPI_Aint get_and_increment() {
+    if (this->_lease_size <= 1) {
+      return this->get_and_increment(1);
+    }
+    if (this->_lease_next == this->_lease_end) {
+      this->_lease_next = this->get_and_increment(this->_lease_size);
+      this->_lease_end = this->_lease_next + this->_lease_size;
+    }
+    return this->_lease_next++;
+  }
+
+  // Reserves `n` consecutive values and returns the first one.
+  inline MPI_Aint get_and_increment(MPI_Aint n) {
     MPI_Aint old_counter;
-    fetch_and_add_sync(&old_counter, 1, 0, this->_host, this->_counter_win);
+    fetch_and_add_sync(&old_counter, n, this->_counter_region.disp(),
+                       this->_host, this->_counter_win);
     return old_counter;
   }
+
+  // Completes when `request` does; `output` must stay valid until then. With
+  // leasing, the value comes from the lease and the request is already
+  // complete.
+  inline void get_and_increment_async(MPI_Aint *output, MPI_Request *request) {
+    if (this->_lease_size > 1) {
+      *output = this->get_and_increment();
+      *request = MPI_REQUEST_NULL;
+      return;
+    }
+    fetch_and_add_request(output, &INCREMENT, this->_counter_region.disp(),
+                          this->_host, this->_counter_win, request);
+  }
 };
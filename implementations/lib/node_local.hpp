@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mpi.h>
+#include <type_traits>
+#include <vector>
+
+// Window allocation with an optional intra-node fast path. With
+// NODE_LOCAL_FAST_PATH defined, win_allocate backs the window with a shared
+// memory segment of the node, and the comm.hpp helpers access node-local
+// targets with CPU atomics instead of RMA. Otherwise it is MPI_Win_allocate.
+//
+// SELF_TARGET_FAST_PATH is the same for the calling rank's own window memory
+// only, e.g. the dequeuer's accesses to the metadata it hosts: it needs no
+// shared memory segment, but the window must have the unified memory model,
+// and every local load is preceded, and every other local access followed,
+// by MPI_Win_sync. NODE_LOCAL_FAST_PATH takes precedence when both are
+// defined.
+//
+// The fast paths mix CPU atomics and MPI atomics on the same locations, so
+// they are only sound when the MPI library performs RMA atomics on those
+// targets with CPU atomics too (e.g. every rank on one node, or an
+// implementation whose network atomics are coherent with the CPU's). Once the
+// window is in use, its memory must only be accessed through those helpers.
+
+#if defined(NODE_LOCAL_FAST_PATH) || defined(SELF_TARGET_FAST_PATH)
+struct node_local_win_t {
+  MPI_Comm sm_comm;
+  MPI_Win sm_win;
+  // Base address and displacement unit per rank of the window's
+  // communicator, nullptr for ranks whose memory is not directly accessed.
+  std::vector<char *> bases;
+  std::vector<int> disp_units;
+};
+
+inline int node_local_keyval() {
+  static int keyval = MPI_KEYVAL_INVALID;
+  if (keyval == MPI_KEYVAL_INVALID) {
+    MPI_Win_create_keyval(MPI_WIN_NULL_COPY_FN, MPI_WIN_NULL_DELETE_FN,
+                          &keyval, nullptr);
+  }
+  return keyval;
+}
+#endif
+
+template <typename T>
+inline void win_allocate(MPI_Aint size, int disp_unit, MPI_Info info,
+                         MPI_Comm comm, T **baseptr, MPI_Win *win) {
+#ifdef NODE_LOCAL_FAST_PATH
+  node_local_win_t *node_local = new node_local_win_t;
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                      &node_local->sm_comm);
+  MPI_Win_allocate_shared(size, disp_unit, info, node_local->sm_comm, baseptr,
+                          &node_local->sm_win);
+  MPI_Win_create(*baseptr, size, disp_unit, info, comm, win);
+
+  int comm_size;
+  MPI_Comm_size(comm, &comm_size);
+  node_local->bases.assign(comm_size, nullptr);
+  node_local->disp_units.assign(comm_size, 0);
+  MPI_Group group;
+  MPI_Group sm_group;
+  MPI_Comm_group(comm, &group);
+  MPI_Comm_group(node_local->sm_comm, &sm_group);
+  for (int rank = 0; rank < comm_size; ++rank) {
+    int sm_rank;
+    MPI_Group_translate_ranks(group, 1, &rank, sm_group, &sm_rank);
+    if (sm_rank == MPI_UNDEFINED) {
+      continue;
+    }
+    MPI_Aint sm_size;
+    MPI_Win_shared_query(node_local->sm_win, sm_rank, &sm_size,
+                         &node_local->disp_units[rank],
+                         &node_local->bases[rank]);
+    if (sm_size == 0) {
+      node_local->bases[rank] = nullptr;
+    }
+  }
+  MPI_Group_free(&group);
+  MPI_Group_free(&sm_group);
+  MPI_Win_set_attr(*win, node_local_keyval(), node_local);
+#elif defined(SELF_TARGET_FAST_PATH)
+  MPI_Win_allocate(size, disp_unit, info, comm, baseptr, win);
+  int *model;
+  int flag;
+  MPI_Win_get_attr(*win, MPI_WIN_MODEL, &model, &flag);
+  if (!flag || *model != MPI_WIN_UNIFIED || size == 0) {
+    return;
+  }
+  node_local_win_t *node_local = new node_local_win_t;
+  node_local->sm_comm = MPI_COMM_NULL;
+  node_local->sm_win = MPI_WIN_NULL;
+  int comm_size;
+  int self_rank;
+  MPI_Comm_size(comm, &comm_size);
+  MPI_Comm_rank(comm, &self_rank);
+  node_local->bases.assign(comm_size, nullptr);
+  node_local->disp_units.assign(comm_size, 0);
+  node_local->bases[self_rank] = reinterpret_cast<char *>(*baseptr);
+  node_local->disp_units[self_rank] = disp_unit;
+  MPI_Win_set_attr(*win, node_local_keyval(), node_local);
+#else
+  MPI_Win_allocate(size, disp_unit, info, comm, baseptr, win);
+#endif
+}
+
+inline void win_free(MPI_Win *win) {
+#if defined(NODE_LOCAL_FAST_PATH) || defined(SELF_TARGET_FAST_PATH)
+  node_local_win_t *node_local;
+  int flag;
+  MPI_Win_get_attr(*win, node_local_keyval(), &node_local, &flag);
+  MPI_Win_free(win);
+  if (flag) {
+    if (node_local->sm_win != MPI_WIN_NULL) {
+      MPI_Win_free(&node_local->sm_win);
+      MPI_Comm_free(&node_local->sm_comm);
+    }
+    delete node_local;
+  }
+#else
+  MPI_Win_free(win);
+#endif
+}
+
+constexpr bool node_local_enabled() {
+#if defined(NODE_LOCAL_FAST_PATH) || defined(SELF_TARGET_FAST_PATH)
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Elements are loaded and stored as atomic words of the same width as the
+// accumulate datatype comm.hpp picks for T.
+template <typename T>
+using node_local_word_t = std::conditional_t<
+    sizeof(T) % 8 == 0, uint64_t,
+    std::conditional_t<sizeof(T) % 4 == 0, uint32_t,
+                       std::conditional_t<sizeof(T) % 2 == 0, uint16_t,
+                                          uint8_t>>>;
+
+// Address of `disp` in the window memory of `rank` if it is directly
+// accessible from this process, nullptr otherwise.
+template <typename T>
+inline T *node_local_ptr(MPI_Aint disp, unsigned int rank, const MPI_Win &win) {
+#if defined(NODE_LOCAL_FAST_PATH) || defined(SELF_TARGET_FAST_PATH)
+  node_local_win_t *node_local;
+  int flag;
+  MPI_Win_get_attr(win, node_local_keyval(), &node_local, &flag);
+  if (!flag || node_local->bases[rank] == nullptr) {
+    return nullptr;
+  }
+  return reinterpret_cast<T *>(node_local->bases[rank] +
+                               disp * node_local->disp_units[rank]);
+#else
+  return nullptr;
+#endif
+}
+
+// Every operation on a node-local target completes immediately, so there is
+// nothing to flush.
+inline bool node_local_target(unsigned int rank, const MPI_Win &win) {
+  if constexpr (!node_local_enabled()) {
+    return false;
+  } else {
+    return node_local_ptr<char>(0, rank, win) != nullptr;
+  }
+}
+
+// Synchronizes the public and private copies of the window around a direct
+// access on the self-target path: before a load, so that it observes
+// completed RMA updates, and after a store, FAA or CAS, so that RMA observes
+// it. The node-local path needs no such step.
+inline void node_local_sync(const MPI_Win &win) {
+#if !defined(NODE_LOCAL_FAST_PATH) && defined(SELF_TARGET_FAST_PATH)
+  MPI_Win_sync(win);
+#else
+  (void)win;
+#endif
+}
+
+template <typename T>
+inline bool node_local_load(T *dst, int size, MPI_Aint disp, unsigned int rank,
+                            const MPI_Win &win) {
+  if constexpr (!node_local_enabled()) {
+    return false;
+  } else {
+    T *local = node_local_ptr<T>(disp, rank, win);
+    if (local == nullptr) {
+      return false;
+    }
+    node_local_sync(win);
+    typedef node_local_word_t<T> word_t;
+    word_t *from = reinterpret_cast<word_t *>(local);
+    word_t *to = reinterpret_cast<word_t *>(dst);
+    for (size_t i = 0; i < size * sizeof(T) / sizeof(word_t); ++i) {
+      to[i] = __atomic_load_n(from + i, __ATOMIC_SEQ_CST);
+    }
+    return true;
+  }
+}
+
+template <typename T>
+inline bool node_local_store(const T *src, int size, MPI_Aint disp,
+                             unsigned int rank, const MPI_Win &win) {
+  if constexpr (!node_local_enabled()) {
+    return false;
+  } else {
+    T *local = node_local_ptr<T>(disp, rank, win);
+    if (local == nullptr) {
+      return false;
+    }
+    typedef node_local_word_t<T> word_t;
+    const word_t *from = reinterpret_cast<const word_t *>(src);
+    word_t *to = reinterpret_cast<word_t *>(local);
+    for (size_t i = 0; i < size * sizeof(T) / sizeof(word_t); ++i) {
+      __atomic_store_n(to + i, from[i], __ATOMIC_SEQ_CST);
+    }
+    node_local_sync(win);
+    return true;
+  }
+}
+
+template <typename T>
+inline bool node_local_fetch_and_add(T *dst, const T *increment, MPI_Aint disp,
+                                     unsigned int rank, const MPI_Win &win) {
+  if constexpr (!node_local_enabled()) {
+    return false;
+  } else {
+    T *local = node_local_ptr<T>(disp, rank, win);
+    if (local == nullptr) {
+      return false;
+    }
+    *dst = __atomic_fetch_add(local, *increment, __ATOMIC_SEQ_CST);
+    node_local_sync(win);
+    return true;
+  }
+}
+
+template <typename T>
+inline bool node_local_compare_and_swap(const T *old_val, const T *new_val,
+                                        T *result, MPI_Aint disp,
+                                        unsigned int rank, const MPI_Win &win) {
+  if constexpr (!node_local_enabled()) {
+    return false;
+  } else {
+    T *local = node_local_ptr<T>(disp, rank, win);
+    if (local == nullptr) {
+      return false;
+    }
+    T expected = *old_val;
+    T desired = *new_val;
+    __atomic_compare_exchange(local, &expected, &desired, false,
+                              __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    *result = expected;
+    node_local_sync(win);
+    return true;
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "window_layout.hpp"
+#include <cstdio>
+#include <mpi.h>
+
+// One window allocated up front that queues carve their regions from, so a
+// queue built on an arena costs no collective call to create or destroy.
+//
+// Every rank must carve the same queues in the same order, which gives each
+// region the same displacement on every rank. A queue only initializes the
+// regions its rank hosts, so after creating a batch of queues call fence()
+// once before any of them is used. release() hands the space of the queues
+// carved after a mark() back to the arena; only call it once no rank
+// accesses those queues any more, e.g. after the phase's closing barrier.
+class QueueArena {
+public:
+  // Every allocation starts at a multiple of this.
+  constexpr static MPI_Aint ALIGNMENT = 64;
+
+private:
+  MPI_Comm _comm;
+  MPI_Info _info = MPI_INFO_NULL;
+  MPI_Win _win = MPI_WIN_NULL;
+  void *_base = nullptr;
+  const MPI_Aint _size;
+  MPI_Aint _top = 0;
+
+public:
+  // `size` is the number of bytes every rank provides, at least the sum of
+  // the arena_size() of the queues alive at the same time.
+  QueueArena(MPI_Aint size, MPI_Comm comm) : _comm{comm}, _size{size} {
+    MPI_Info_create(&this->_info);
+    MPI_Info_set(this->_info, "same_disp_unit", "true");
+    MPI_Info_set(this->_info, "accumulate_ordering", "none");
+    MPI_Info_set(this->_info, "which_accumulate_ops",
+                 "replace,no_op,sum,cswap");
+
+    win_allocate(size, 1, this->_info, comm, &this->_base, &this->_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_win);
+    MPI_Win_flush_all(this->_win);
+    MPI_Barrier(comm);
+    MPI_Win_flush_all(this->_win);
+  }
+
+  QueueArena(const QueueArena &) = delete;
+  QueueArena &operator=(const QueueArena &) = delete;
+
+  ~QueueArena() {
+    if (this->_win != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(this->_win);
+      win_free(&this->_win);
+    }
+    if (this->_info != MPI_INFO_NULL) {
+      MPI_Info_free(&this->_info);
+    }
+  }
+
+  MPI_Comm comm() const { return this->_comm; }
+
+  MPI_Win win() const { return this->_win; }
+
+  // Layout whose regions start at the free part of the arena.
+  WindowLayout layout() const { return WindowLayout(this->_top); }
+
+  // Takes the space of `layout`, which must come from layout() with no
+  // allocation in between, and returns the local base of the arena.
+  void *allocate(const WindowLayout &layout) {
+    if (layout.extent() > this->_size) {
+      fprintf(stderr, "QueueArena: %ld bytes requested, %ld available\n",
+              (long)(layout.extent() - this->_top),
+              (long)(this->_size - this->_top));
+      MPI_Abort(this->_comm, 1);
+    }
+    this->_top = (layout.extent() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    return this->_base;
+  }
+
+  // Arena space a layout started at 0 takes when allocated from an arena.
+  static MPI_Aint footprint(const WindowLayout &layout) {
+    return (layout.extent() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  }
+
+  MPI_Aint mark() const { return this->_top; }
+
+  void release(MPI_Aint mark) { this->_top = mark; }
+
+  // Collective; publishes the initialization of the queues carved since the
+  // last fence.
+  void fence() {
+    MPI_Win_flush_all(this->_win);
+    MPI_Barrier(this->_comm);
+    MPI_Win_flush_all(this->_win);
+  }
+};
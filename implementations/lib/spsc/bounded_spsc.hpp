@@ -1,41 +1,259 @@
 #pragma once
 
 #include "../comm.hpp"
+#include "../queue_arena.hpp"
+#include "../window_layout.hpp"
+#include "last_publication.hpp"
 #include <algorithm>
 #include <mpi.h>
 #include <vector>
 
 template <typename data_t> class Spsc {
+public:
+  // Room for `size` items to construct in place, see reserve().
+  struct reservation_t {
+    data_t *data;
+    MPI_Aint size;
+  };
+
+private:
   int _self_rank;
   const MPI_Aint _dequeuer_rank;
 
   const MPI_Aint _capacity;
 
-  MPI_Win _data_win = MPI_WIN_NULL;
+  // Every rank hosts a ring and its local last index; the dequeuer also
+  // hosts the first and last indexes of every enqueuer.
+  MPI_Win _win = MPI_WIN_NULL;
+  // False when the regions live in a QueueArena's window.
+  bool _owns_win = true;
+  // Whether this rank writes its own ring and local last index with plain
+  // stores rather than RMA to itself, see win_unified().
+  bool _local_stores = false;
+
+  WindowLayout::Region<data_t> _data_region;
   data_t *_data_ptr = nullptr;
 
-  MPI_Win _first_win = MPI_WIN_NULL;
+  WindowLayout::Region<MPI_Aint> _first_region;
   MPI_Aint *_first_ptr = nullptr;
   std::vector<MPI_Aint> _first_buf;
 
-  MPI_Win _last_win = MPI_WIN_NULL;
+  WindowLayout::Region<MPI_Aint> _last_region;
   MPI_Aint *_last_ptr = nullptr;
-  MPI_Win _enqueuer_local_last_win = MPI_WIN_NULL;
+  WindowLayout::Region<MPI_Aint> _enqueuer_local_last_region;
   MPI_Aint *_enqueuer_local_last_ptr = nullptr;
   std::vector<MPI_Aint> _last_buf;
+  // Where reserve() has items constructed when the ring cannot take them.
+  std::vector<data_t> _staging;
 
   MPI_Info _info = MPI_INFO_NULL;
 
   int _comm_size;
+  // Bound of the dequeue cache depth, in multiples of _batch_size.
+  constexpr static MPI_Aint MAX_REFILL_SCALE = 8;
   MPI_Aint _batch_size;
+  MPI_Aint _max_refill = 0;
   data_t **_cached_data = nullptr;
   MPI_Aint *_cached_size = nullptr;
+  MPI_Aint *_cached_offset = nullptr;
+
+  LastPublication _publication;
+  MPI_Aint _publication_interval;
+  MPI_Aint _last_published = 0;
+  double _last_publication_time = 0;
+  PublicationStats _publication_stats = {};
+  queue_stats_t _stats = {};
+
+  bool _should_publish(MPI_Aint old_last, MPI_Aint new_last) const {
+    switch (this->_publication) {
+    case LastPublication::EVERY_N:
+      return new_last / this->_publication_interval !=
+             old_last / this->_publication_interval;
+    case LastPublication::TIMED:
+      return (MPI_Wtime() - this->_last_publication_time) * 1e6 >=
+             this->_publication_interval;
+    case LastPublication::ON_EMPTY:
+      return this->_first_buf[this->_self_rank] >= this->_last_published;
+    }
+    return true;
+  }
+
+  void _mark_published(MPI_Aint new_last) {
+    this->_last_published = new_last;
+    if (this->_publication == LastPublication::TIMED) {
+      this->_last_publication_time = MPI_Wtime();
+    }
+    ++this->_publication_stats.publications;
+  }
+
+  // Whether the ring has room up to `new_last`, reading the first index from
+  // the dequeuer if the cached one says otherwise.
+  bool _e_has_room(MPI_Aint new_last) {
+    if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
+      stats_count_cache_miss();
+      aread_sync(&this->_first_buf[this->_self_rank],
+                 this->_first_region.disp(this->_self_rank),
+                 this->_dequeuer_rank, this->_win);
+      if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
+        return false;
+      }
+    } else {
+      stats_count_cache_hit();
+    }
+    return true;
+  }
+
+  // Writes `size` items at the end of the ring, then the local last index.
+  void _e_write(const data_t *data, MPI_Aint size) {
+    const MPI_Aint new_last = this->_last_buf[this->_self_rank] + size;
+    // At most two contiguous segments, split at the wraparound
+    const MPI_Aint start = this->_last_buf[this->_self_rank] % this->_capacity;
+    const MPI_Aint head_size = std::min(size, this->_capacity - start);
+    if (this->_local_stores) {
+      // The release store keeps the items ahead of the index, and the sync
+      // makes both visible before last is published.
+      std::copy(data, data + head_size, this->_data_ptr + start);
+      std::copy(data + head_size, data + size, this->_data_ptr);
+      __atomic_store_n(this->_enqueuer_local_last_ptr, new_last,
+                       __ATOMIC_RELEASE);
+      MPI_Win_sync(this->_win);
+    } else {
+      batch_awrite_async(data, head_size, this->_data_region.disp(start),
+                         this->_self_rank, this->_win);
+      if (head_size < size) {
+        batch_awrite_async(data + head_size, size - head_size,
+                           this->_data_region.disp(0), this->_self_rank,
+                           this->_win);
+      }
+      flush(this->_self_rank, this->_win);
+      awrite_sync(&new_last, this->_enqueuer_local_last_region.disp(),
+                  this->_self_rank, this->_win);
+    }
+  }
+
+  void _e_publish(MPI_Aint new_last) {
+    if (this->_should_publish(this->_last_buf[this->_self_rank], new_last)) {
+      awrite_sync(&new_last, this->_last_region.disp(this->_self_rank),
+                  this->_dequeuer_rank, this->_win);
+      this->_mark_published(new_last);
+    }
+    this->_last_buf[this->_self_rank] = new_last;
+  }
+
+  // Fills the cache from the front of the enqueuer's ring, using at most two
+  // ranged gets split at the wraparound. The depth follows the observed
+  // backlog: half of it, between _batch_size and _max_refill items, so a deep
+  // ring drains in fewer, larger gets; fewer if the ring holds less.
+  void _refill_cache(int enqueuer_rank) {
+    const MPI_Aint first = this->_first_buf[enqueuer_rank];
+    const MPI_Aint backlog = this->_last_buf[enqueuer_rank] - first;
+    const MPI_Aint depth = std::min(this->_max_refill,
+                                    std::max(this->_batch_size, backlog / 2));
+    const MPI_Aint nreads = std::min(depth, backlog);
+    const MPI_Aint start = first % this->_capacity;
+    const MPI_Aint head_size = std::min(nreads, this->_capacity - start);
+    batch_aread_async(this->_cached_data[enqueuer_rank], head_size,
+                      this->_data_region.disp(start), enqueuer_rank,
+                      this->_win);
+    if (head_size < nreads) {
+      batch_aread_async(this->_cached_data[enqueuer_rank] + head_size,
+                        nreads - head_size, this->_data_region.disp(0),
+                        enqueuer_rank, this->_win);
+    }
+    flush(enqueuer_rank, this->_win);
+    this->_cached_size[enqueuer_rank] = nreads;
+    this->_cached_offset[enqueuer_rank] = 0;
+  }
+
+  // Shared-consumer reads bypass the dequeuer's cached indexes and data: the
+  // first index is read from the host and the item is only trusted if the
+  // first index did not move while it was read.
+  bool _d_shared_has_item(MPI_Aint first, int enqueuer_rank) {
+    if (first < this->_last_buf[enqueuer_rank]) {
+      return true;
+    }
+    aread_sync(&this->_last_buf[enqueuer_rank],
+               this->_last_region.disp(enqueuer_rank), this->_dequeuer_rank,
+               this->_win);
+    ++this->_publication_stats.last_reads;
+    if (first < this->_last_buf[enqueuer_rank]) {
+      return true;
+    }
+    aread_sync(&this->_last_buf[enqueuer_rank],
+               this->_enqueuer_local_last_region.disp(), enqueuer_rank,
+               this->_win);
+    ++this->_publication_stats.fallback_reads;
+    if (first < this->_last_buf[enqueuer_rank]) {
+      return true;
+    }
+    ++this->_publication_stats.empty_fallback_reads;
+    return false;
+  }
+
+  bool _d_shared_read_front(data_t *output, MPI_Aint *first,
+                            int enqueuer_rank) {
+    while (true) {
+      aread_sync(first, this->_first_region.disp(enqueuer_rank),
+                 this->_dequeuer_rank, this->_win);
+      if (!this->_d_shared_has_item(*first, enqueuer_rank)) {
+        return false;
+      }
+      aread_sync(output, this->_data_region.disp(*first % this->_capacity),
+                 enqueuer_rank, this->_win);
+      MPI_Aint current_first;
+      aread_sync(&current_first, this->_first_region.disp(enqueuer_rank),
+                 this->_dequeuer_rank, this->_win);
+      if (current_first == *first) {
+        return true;
+      }
+    }
+  }
+
+  void _add_regions(WindowLayout &layout) {
+    const bool is_dequeuer = this->_self_rank == this->_dequeuer_rank;
+    this->_data_region = layout.add<data_t>(this->_capacity, true);
+    this->_enqueuer_local_last_region = layout.add<MPI_Aint>(1, true);
+    this->_first_region = layout.add<MPI_Aint>(this->_comm_size, is_dequeuer);
+    this->_last_region = layout.add<MPI_Aint>(this->_comm_size, is_dequeuer);
+  }
+
+  // Initializes the regions hosted by this rank; the window must be locked.
+  void _initialize(void *base) {
+    this->_local_stores = win_unified(this->_win);
+    this->_data_ptr = this->_data_region.ptr(base);
+    this->_enqueuer_local_last_ptr =
+        this->_enqueuer_local_last_region.ptr(base);
+
+    if (this->_self_rank == this->_dequeuer_rank) {
+      this->_max_refill =
+          std::max(this->_batch_size,
+                   std::min(this->_capacity,
+                            MAX_REFILL_SCALE * this->_batch_size));
+      this->_first_ptr = this->_first_region.ptr(base);
+      this->_last_ptr = this->_last_region.ptr(base);
+      this->_cached_data =
+          (data_t **)malloc(sizeof(data_t *) * this->_comm_size);
+      this->_cached_size =
+          (MPI_Aint *)malloc(sizeof(MPI_Aint) * this->_comm_size);
+      this->_cached_offset =
+          (MPI_Aint *)malloc(sizeof(MPI_Aint) * this->_comm_size);
+      for (int i = 0; i < this->_comm_size; ++i) {
+        this->_cached_data[i] =
+            (data_t *)malloc(sizeof(data_t) * this->_max_refill);
+      }
+    }
+    this->reset();
+  }
 
 public:
   Spsc(MPI_Aint capacity, MPI_Aint dequeuer_rank, MPI_Comm comm,
-       MPI_Aint batch_size = 10)
+       MPI_Aint batch_size = 10,
+       LastPublication publication = LastPublication::EVERY_N,
+       MPI_Aint publication_interval = 10)
       : _dequeuer_rank{dequeuer_rank}, _capacity{capacity}, _first_buf{0},
-        _last_buf{0}, _batch_size{batch_size} {
+        _last_buf{0}, _batch_size{batch_size},
+        _publication{publication},
+        _publication_interval{std::max<MPI_Aint>(publication_interval, 1)} {
     MPI_Comm_rank(comm, &this->_self_rank);
     MPI_Comm_size(comm, &this->_comm_size);
     _first_buf = std::vector<MPI_Aint>(this->_comm_size);
@@ -44,85 +262,80 @@ public:
     MPI_Info_create(&this->_info);
     MPI_Info_set(this->_info, "same_disp_unit", "true");
     MPI_Info_set(this->_info, "accumulate_ordering", "none");
+    MPI_Info_set(this->_info, "which_accumulate_ops", "replace,no_op,cswap");
+
+    WindowLayout layout;
+    this->_add_regions(layout);
+    void *base = layout.allocate(this->_info, comm, &this->_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_win);
+    this->_initialize(base);
+    MPI_Win_flush_all(this->_win);
+    MPI_Barrier(comm);
+    MPI_Win_flush_all(this->_win);
+  }
 
-    if (this->_self_rank == dequeuer_rank) {
-      MPI_Win_allocate(capacity * sizeof(data_t), sizeof(data_t), this->_info,
-                       comm, &this->_data_ptr, &this->_data_win);
-      MPI_Win_allocate(this->_comm_size * sizeof(MPI_Aint), sizeof(MPI_Aint),
-                       this->_info, comm, &this->_first_ptr, &this->_first_win);
-      MPI_Win_allocate(this->_comm_size * sizeof(MPI_Aint), sizeof(MPI_Aint),
-                       this->_info, comm, &this->_last_ptr, &this->_last_win);
-      MPI_Win_allocate(0, sizeof(MPI_Aint), this->_info, comm,
-                       &this->_enqueuer_local_last_ptr,
-                       &this->_enqueuer_local_last_win);
-      this->_cached_data =
-          (data_t **)malloc(sizeof(data_t *) * this->_comm_size);
-      this->_cached_size =
-          (MPI_Aint *)malloc(sizeof(MPI_Aint) * this->_comm_size);
-      for (int i = 0; i < this->_comm_size; ++i) {
-        this->_cached_data[i] =
-            (data_t *)malloc(sizeof(data_t) * this->_batch_size);
-        this->_cached_size[i] = 0;
-      }
+  // Carves the queue from `arena`; see QueueArena for the protocol.
+  Spsc(MPI_Aint capacity, MPI_Aint dequeuer_rank, QueueArena &arena,
+       MPI_Aint batch_size = 10,
+       LastPublication publication = LastPublication::EVERY_N,
+       MPI_Aint publication_interval = 10)
+      : _dequeuer_rank{dequeuer_rank}, _capacity{capacity},
+        _win{arena.win()}, _owns_win{false}, _batch_size{batch_size},
+        _publication{publication},
+        _publication_interval{std::max<MPI_Aint>(publication_interval, 1)} {
+    MPI_Comm_rank(arena.comm(), &this->_self_rank);
+    MPI_Comm_size(arena.comm(), &this->_comm_size);
+    _first_buf = std::vector<MPI_Aint>(this->_comm_size);
+    _last_buf = std::vector<MPI_Aint>(this->_comm_size);
 
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _first_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _last_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _data_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _enqueuer_local_last_win);
-      for (int i = 0; i < this->_comm_size; ++i) {
-        this->_first_ptr[i] = 0;
-        this->_last_ptr[i] = 0;
-      }
-    } else {
-      MPI_Win_allocate(capacity * sizeof(data_t), sizeof(data_t), this->_info,
-                       comm, &this->_data_ptr, &this->_data_win);
-      MPI_Win_allocate(0, sizeof(MPI_Aint), this->_info, comm,
-                       &this->_first_ptr, &this->_first_win);
-      MPI_Win_allocate(0, sizeof(MPI_Aint), this->_info, comm, &this->_last_ptr,
-                       &this->_last_win);
-      MPI_Win_allocate(sizeof(MPI_Aint), sizeof(MPI_Aint), this->_info, comm,
-                       &this->_enqueuer_local_last_ptr,
-                       &this->_enqueuer_local_last_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _first_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _last_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _data_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _enqueuer_local_last_win);
-      *_enqueuer_local_last_ptr = 0;
-    }
-    MPI_Win_flush_all(this->_data_win);
-    MPI_Win_flush_all(this->_first_win);
-    MPI_Win_flush_all(this->_last_win);
-    MPI_Win_flush_all(this->_enqueuer_local_last_win);
-    MPI_Barrier(comm);
-    MPI_Win_flush_all(this->_data_win);
-    MPI_Win_flush_all(this->_first_win);
-    MPI_Win_flush_all(this->_last_win);
-    MPI_Win_flush_all(this->_enqueuer_local_last_win);
+    WindowLayout layout = arena.layout();
+    this->_add_regions(layout);
+    this->_initialize(arena.allocate(layout));
+  }
+
+  // Arena space one queue takes on a communicator of `comm_size` ranks.
+  static MPI_Aint arena_size(MPI_Aint capacity, int comm_size) {
+    WindowLayout layout;
+    layout.add<data_t>(capacity, true);
+    layout.add<MPI_Aint>(1, true);
+    layout.add<MPI_Aint>(comm_size, true);
+    layout.add<MPI_Aint>(comm_size, true);
+    return QueueArena::footprint(layout);
   }
 
   Spsc(Spsc &&other) noexcept
       : _self_rank(other._self_rank), _dequeuer_rank(other._dequeuer_rank),
-        _capacity(other._capacity), _data_win(other._data_win),
-        _data_ptr(other._data_ptr), _first_win(other._first_win),
-        _first_ptr(other._first_ptr), _first_buf(std::move(other._first_buf)),
-        _last_win(other._last_win), _last_ptr(other._last_ptr),
-        _enqueuer_local_last_win(other._enqueuer_local_last_win),
+        _capacity(other._capacity), _win(other._win),
+        _owns_win(other._owns_win), _local_stores(other._local_stores),
+        _data_region(other._data_region),
+        _data_ptr(other._data_ptr),
+        _first_region(other._first_region), _first_ptr(other._first_ptr),
+        _first_buf(std::move(other._first_buf)),
+        _last_region(other._last_region), _last_ptr(other._last_ptr),
+        _enqueuer_local_last_region(other._enqueuer_local_last_region),
         _enqueuer_local_last_ptr(other._enqueuer_local_last_ptr),
-        _last_buf(std::move(other._last_buf)), _info(other._info),
+        _last_buf(std::move(other._last_buf)),
+        _staging(std::move(other._staging)), _info(other._info),
         _comm_size(other._comm_size), _batch_size(other._batch_size),
-        _cached_data(other._cached_data), _cached_size(other._cached_size) {
-
-    other._data_win = MPI_WIN_NULL;
+        _max_refill(other._max_refill), _cached_data(other._cached_data),
+        _cached_size(other._cached_size),
+        _cached_offset(other._cached_offset),
+        _publication(other._publication),
+        _publication_interval(other._publication_interval),
+        _last_published(other._last_published),
+        _last_publication_time(other._last_publication_time),
+        _publication_stats(other._publication_stats),
+        _stats(other._stats) {
+
+    other._win = MPI_WIN_NULL;
     other._data_ptr = nullptr;
-    other._first_win = MPI_WIN_NULL;
     other._first_ptr = nullptr;
-    other._last_win = MPI_WIN_NULL;
     other._last_ptr = nullptr;
-    other._enqueuer_local_last_win = MPI_WIN_NULL;
     other._enqueuer_local_last_ptr = nullptr;
     other._info = MPI_INFO_NULL;
     other._cached_data = nullptr;
     other._cached_size = nullptr;
+    other._cached_offset = nullptr;
   }
 
   Spsc(const Spsc &) = delete;
@@ -130,15 +343,9 @@ public:
   Spsc &operator=(Spsc &&) = delete;
 
   ~Spsc() {
-    if (_data_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_first_win);
-      MPI_Win_unlock_all(_last_win);
-      MPI_Win_unlock_all(_enqueuer_local_last_win);
-      MPI_Win_unlock_all(_data_win);
-      MPI_Win_free(&this->_data_win);
-      MPI_Win_free(&this->_first_win);
-      MPI_Win_free(&this->_last_win);
-      MPI_Win_free(&this->_enqueuer_local_last_win);
+    if (_win != MPI_WIN_NULL && _owns_win) {
+      MPI_Win_unlock_all(_win);
+      win_free(&this->_win);
     }
 
     if (_info != MPI_INFO_NULL) {
@@ -152,140 +359,233 @@ public:
       }
       free(this->_cached_data);
       free(this->_cached_size);
+      free(this->_cached_offset);
     }
   }
 
-  bool enqueue(const data_t &data) {
-    MPI_Aint new_last = this->_last_buf[this->_self_rank] + 1;
+  bool enqueue(const data_t &data) { return this->enqueue(&data, 1); }
 
-    if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
-      aread_sync(&this->_first_buf[this->_self_rank], this->_self_rank,
-                 this->_dequeuer_rank, this->_first_win);
-      if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
-        return false;
-      }
-    }
+  bool enqueue(const std::vector<data_t> &data) {
+    return this->enqueue(data.data(), data.size());
+  }
+
+  bool enqueue(const data_t *data, MPI_Aint size) {
+    StatsScope stats_scope(this->_stats);
+    MPI_Aint new_last = this->_last_buf[this->_self_rank] + size;
 
-    awrite_sync(&data, this->_last_buf[this->_self_rank] % this->_capacity,
-                this->_self_rank, this->_data_win);
-    awrite_sync(&new_last, 0, this->_self_rank, this->_enqueuer_local_last_win);
-    if (new_last % 10 == 0) {
-      awrite_sync(&new_last, this->_self_rank, this->_dequeuer_rank,
-                  this->_last_win);
+    if (!this->_e_has_room(new_last)) {
+      return false;
     }
-    this->_last_buf[this->_self_rank] = new_last;
+    this->_e_write(data, size);
+    this->_e_publish(new_last);
 
     return true;
   }
 
-  bool enqueue(const std::vector<data_t> &data) {
-    MPI_Aint new_last = this->_last_buf[this->_self_rank] + data.size();
-
-    if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
-      aread_sync(&this->_first_buf[this->_self_rank], this->_self_rank,
-                 this->_dequeuer_rank, this->_first_win);
-      if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
-        return false;
-      }
+  // Reserves room for `size` items at the end of the ring and returns where
+  // to construct them: the ring itself when this rank stores to it locally
+  // and the items do not wrap around, a staging buffer otherwise. `data` is
+  // nullptr if the ring is full. No other enqueue may happen until the
+  // reservation is committed.
+  reservation_t reserve(MPI_Aint size) {
+    StatsScope stats_scope(this->_stats);
+    if (!this->_e_has_room(this->_last_buf[this->_self_rank] + size)) {
+      return reservation_t{nullptr, 0};
     }
-
-    const uint64_t size = data.size();
-    for (int i = 0; i < size; ++i) {
-      const uint64_t disp =
-          (this->_last_buf[this->_self_rank] + i) % this->_capacity;
-      awrite_async(data.data() + i, disp, this->_self_rank, this->_data_win);
+    const MPI_Aint start = this->_last_buf[this->_self_rank] % this->_capacity;
+    if (this->_local_stores && start + size <= this->_capacity) {
+      return reservation_t{this->_data_ptr + start, size};
     }
-    flush(this->_self_rank, this->_data_win);
-    awrite_sync(&new_last, this->_self_rank, this->_dequeuer_rank,
-                this->_last_win);
-    this->_last_buf[this->_self_rank] = new_last;
+    this->_staging.resize(size);
+    return reservation_t{this->_staging.data(), size};
+  }
 
-    return true;
+  // Publishes the reserved items, with a single update of the last index
+  // when they were constructed in the ring.
+  void commit(const reservation_t &reservation) {
+    StatsScope stats_scope(this->_stats);
+    const MPI_Aint new_last =
+        this->_last_buf[this->_self_rank] + reservation.size;
+    if (reservation.data == this->_staging.data()) {
+      this->_e_write(reservation.data, reservation.size);
+    } else {
+      __atomic_store_n(this->_enqueuer_local_last_ptr, new_last,
+                       __ATOMIC_RELEASE);
+      MPI_Win_sync(this->_win);
+    }
+    this->_e_publish(new_last);
   }
 
-  bool e_read_front(data_t *output) {
+  // The enqueuer's first index, read from the dequeuer unless the ring is
+  // known to be empty; false if the ring is empty.
+  bool e_read_first(MPI_Aint *first) {
+    StatsScope stats_scope(this->_stats);
+    if (this->_first_buf[this->_self_rank] >=
+        this->_last_buf[this->_self_rank]) {
+      return false;
+    }
+    aread_sync(&this->_first_buf[this->_self_rank],
+               this->_first_region.disp(this->_self_rank), this->_dequeuer_rank,
+               this->_win);
     if (this->_first_buf[this->_self_rank] >=
         this->_last_buf[this->_self_rank]) {
       return false;
     }
-    aread_sync(&this->_first_buf[this->_self_rank], this->_self_rank,
-               this->_dequeuer_rank, this->_first_win);
-    if (this->_first_buf >= this->_last_buf) {
+    *first = this->_first_buf[this->_self_rank];
+    return true;
+  }
+
+  bool e_read_front(data_t *output) {
+    StatsScope stats_scope(this->_stats);
+    MPI_Aint first;
+    if (!this->e_read_first(&first)) {
       return false;
     }
 
+    const MPI_Aint index = first % this->_capacity;
+    if (this->_local_stores) {
+      *output = this->_data_ptr[index];
+      return true;
+    }
     data_t data;
-    aread_sync(&data, this->_first_buf[this->_self_rank] % this->_capacity,
-               this->_self_rank, this->_data_win);
+    aread_sync(&data, this->_data_region.disp(index), this->_self_rank,
+               this->_win);
 
     *output = data;
     return true;
   }
 
   bool dequeue(data_t *output, int enqueuer_rank) {
-    MPI_Aint new_first = this->_first_buf[enqueuer_rank] + 1;
+    return this->dequeue(output, 1, enqueuer_rank);
+  }
+
+  // Dequeues exactly `count` items into `output`, or none if fewer are
+  // available, writing the first index once.
+  bool dequeue(data_t *output, MPI_Aint count, int enqueuer_rank) {
+    StatsScope stats_scope(this->_stats);
+    MPI_Aint new_first = this->_first_buf[enqueuer_rank] + count;
     if (new_first > this->_last_buf[enqueuer_rank]) {
-      aread_sync(&this->_last_buf[enqueuer_rank], enqueuer_rank,
-                 this->_self_rank, this->_last_win);
+      stats_count_cache_miss();
+      aread_sync(&this->_last_buf[enqueuer_rank],
+                 this->_last_region.disp(enqueuer_rank), this->_self_rank,
+                 this->_win);
+      ++this->_publication_stats.last_reads;
       if (new_first > this->_last_buf[enqueuer_rank]) {
-        aread_sync(&this->_last_buf[enqueuer_rank], 0, enqueuer_rank,
-                   this->_enqueuer_local_last_win);
+        aread_sync(&this->_last_buf[enqueuer_rank],
+                   this->_enqueuer_local_last_region.disp(), enqueuer_rank,
+                   this->_win);
+        ++this->_publication_stats.fallback_reads;
         if (new_first > this->_last_buf[enqueuer_rank]) {
+          ++this->_publication_stats.empty_fallback_reads;
           return false;
         }
       }
+    } else {
+      stats_count_cache_hit();
     }
 
-    if (this->_cached_size[enqueuer_rank] > 0) {
-      *output = this->_cached_data[enqueuer_rank]
-                                  [this->_cached_size[enqueuer_rank] - 1];
-      --this->_cached_size[enqueuer_rank];
-    } else {
-      aread_async(output, this->_first_buf[enqueuer_rank] % this->_capacity,
-                  enqueuer_rank, this->_data_win);
-      int nreads = std::min(this->_batch_size,
-                            this->_last_buf[enqueuer_rank] - new_first);
-      this->_cached_size[enqueuer_rank] = nreads;
-      for (int i = 0; i < nreads; ++i) {
-        aread_async(this->_cached_data[enqueuer_rank] + nreads - i - 1,
-                    (new_first + i) % this->_capacity, enqueuer_rank,
-                    this->_data_win);
+    // The cache starts at the local first index, so it advances per item
+    for (MPI_Aint i = 0; i < count; ++i) {
+      if (this->_cached_size[enqueuer_rank] <= 0) {
+        stats_count_cache_miss();
+        this->_refill_cache(enqueuer_rank);
+      } else {
+        stats_count_cache_hit();
       }
-      flush(enqueuer_rank, this->_data_win);
+      output[i] = this->_cached_data[enqueuer_rank]
+                                    [this->_cached_offset[enqueuer_rank]];
+      ++this->_cached_offset[enqueuer_rank];
+      --this->_cached_size[enqueuer_rank];
+      ++this->_first_buf[enqueuer_rank];
     }
-    awrite_sync(&new_first, enqueuer_rank, this->_self_rank, this->_first_win);
-    this->_first_buf[enqueuer_rank] = new_first;
+    awrite_sync(&new_first, this->_first_region.disp(enqueuer_rank),
+                this->_self_rank, this->_win);
 
     return true;
   }
 
   bool d_read_front(data_t *output, int enqueuer_rank) {
+    StatsScope stats_scope(this->_stats);
     if (this->_first_buf[enqueuer_rank] >= this->_last_buf[enqueuer_rank]) {
-      aread_sync(&this->_last_buf[enqueuer_rank], enqueuer_rank,
-                 this->_self_rank, this->_last_win);
+      stats_count_cache_miss();
+      aread_sync(&this->_last_buf[enqueuer_rank],
+                 this->_last_region.disp(enqueuer_rank), this->_self_rank,
+                 this->_win);
+      ++this->_publication_stats.last_reads;
       if (this->_first_buf[enqueuer_rank] >= this->_last_buf[enqueuer_rank]) {
-        aread_sync(&this->_last_buf[enqueuer_rank], 0, enqueuer_rank,
-                   this->_enqueuer_local_last_win);
+        aread_sync(&this->_last_buf[enqueuer_rank],
+                   this->_enqueuer_local_last_region.disp(), enqueuer_rank,
+                   this->_win);
+        ++this->_publication_stats.fallback_reads;
         if (this->_first_buf[enqueuer_rank] >= this->_last_buf[enqueuer_rank]) {
+          ++this->_publication_stats.empty_fallback_reads;
           return false;
         }
       }
+    } else {
+      stats_count_cache_hit();
     }
 
     if (this->_cached_size[enqueuer_rank] <= 0) {
-      int nreads =
-          std::min(this->_batch_size, this->_last_buf[enqueuer_rank] -
-                                          this->_first_buf[enqueuer_rank]);
-      this->_cached_size[enqueuer_rank] = nreads;
-      for (int i = 0; i < nreads; ++i) {
-        aread_async(this->_cached_data[enqueuer_rank] + nreads - i - 1,
-                    (this->_first_buf[enqueuer_rank] + i) % this->_capacity,
-                    enqueuer_rank, this->_data_win);
-      }
-      flush(enqueuer_rank, this->_data_win);
+      stats_count_cache_miss();
+      this->_refill_cache(enqueuer_rank);
+    } else {
+      stats_count_cache_hit();
     }
     *output = this->_cached_data[enqueuer_rank]
-                                [this->_cached_size[enqueuer_rank] - 1];
+                                [this->_cached_offset[enqueuer_rank]];
+    return true;
+  }
+
+  // Empties the ring: reinitializes the indexes this rank hosts and its
+  // cached ones. It does not synchronize; the owning queue's reset() does.
+  void reset() {
+    *this->_enqueuer_local_last_ptr = 0;
+    std::fill(this->_first_buf.begin(), this->_first_buf.end(), 0);
+    std::fill(this->_last_buf.begin(), this->_last_buf.end(), 0);
+    this->_last_published = 0;
+    this->_last_publication_time = 0;
+    if (this->_self_rank == this->_dequeuer_rank) {
+      for (int i = 0; i < this->_comm_size; ++i) {
+        this->_first_ptr[i] = 0;
+        this->_last_ptr[i] = 0;
+        this->_cached_size[i] = 0;
+        this->_cached_offset[i] = 0;
+      }
+    }
+  }
+
+  PublicationStats publication_stats() const {
+    return this->_publication_stats;
+  }
+
+  queue_stats_t stats() const { return this->_stats; }
+
+  // Multi-consumer counterparts of d_read_front and dequeue, callable from
+  // any rank. An item is claimed by CAS on the enqueuer's first index; false
+  // means the ring was empty or another consumer claimed the front first.
+  bool d_shared_read_front(data_t *output, int enqueuer_rank) {
+    StatsScope stats_scope(this->_stats);
+    MPI_Aint first;
+    return this->_d_shared_read_front(output, &first, enqueuer_rank);
+  }
+
+  bool d_claim(data_t *output, int enqueuer_rank) {
+    StatsScope stats_scope(this->_stats);
+    data_t front;
+    MPI_Aint first;
+    if (!this->_d_shared_read_front(&front, &first, enqueuer_rank)) {
+      return false;
+    }
+    const MPI_Aint new_first = first + 1;
+    MPI_Aint result;
+    compare_and_swap_sync(&first, &new_first, &result,
+                          this->_first_region.disp(enqueuer_rank),
+                          this->_dequeuer_rank, this->_win);
+    if (result != first) {
+      return false;
+    }
+    *output = front;
     return true;
   }
 };
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../comm.hpp"
+#include "../window_layout.hpp"
+#include "last_publication.hpp"
 #include <algorithm>
 #include <mpi.h>
 #include <vector>
@@ -11,16 +13,23 @@ template <typename data_t> class HostedBoundedSpsc {
 
   const MPI_Aint _capacity;
 
-  MPI_Win _data_win = MPI_WIN_NULL;
+  // Every rank hosts its local last index; the dequeuer also hosts the rings
+  // and the first and last indexes of every enqueuer.
+  MPI_Win _win = MPI_WIN_NULL;
+  // Whether this rank writes its local last index with a plain store rather
+  // than RMA to itself, see win_unified().
+  bool _local_stores = false;
+
+  WindowLayout::Region<data_t> _data_region;
   data_t *_data_ptr = nullptr;
 
-  MPI_Win _first_win = MPI_WIN_NULL;
+  WindowLayout::Region<MPI_Aint> _first_region;
   MPI_Aint *_first_ptr = nullptr;
   std::vector<MPI_Aint> _first_buf;
 
-  MPI_Win _last_win = MPI_WIN_NULL;
+  WindowLayout::Region<MPI_Aint> _last_region;
   MPI_Aint *_last_ptr = nullptr;
-  MPI_Win _enqueuer_local_last_win = MPI_WIN_NULL;
+  WindowLayout::Region<MPI_Aint> _enqueuer_local_last_region;
   MPI_Aint *_enqueuer_local_last_ptr = nullptr;
   std::vector<MPI_Aint> _last_buf;
 
@@ -30,12 +39,69 @@ template <typename data_t> class HostedBoundedSpsc {
   MPI_Aint _batch_size;
   data_t **_cached_data = nullptr;
   MPI_Aint *_cached_size = nullptr;
+  MPI_Aint *_cached_offset = nullptr;
+
+  LastPublication _publication;
+  MPI_Aint _publication_interval;
+  MPI_Aint _last_published = 0;
+  double _last_publication_time = 0;
+  PublicationStats _publication_stats = {};
+  queue_stats_t _stats = {};
+
+  bool _should_publish(MPI_Aint new_last) const {
+    switch (this->_publication) {
+    case LastPublication::EVERY_N:
+      return new_last % this->_publication_interval == 0;
+    case LastPublication::TIMED:
+      return (MPI_Wtime() - this->_last_publication_time) * 1e6 >=
+             this->_publication_interval;
+    case LastPublication::ON_EMPTY:
+      return this->_first_buf[this->_self_rank] >= this->_last_published;
+    }
+    return true;
+  }
+
+  void _mark_published(MPI_Aint new_last) {
+    this->_last_published = new_last;
+    if (this->_publication == LastPublication::TIMED) {
+      this->_last_publication_time = MPI_Wtime();
+    }
+    ++this->_publication_stats.publications;
+  }
+
+  // Fills the cache with up to _batch_size items from the front of the
+  // enqueuer's ring, fewer if the ring holds less, using at most two ranged
+  // gets split at the wraparound.
+  void _refill_cache(int enqueuer_rank) {
+    const MPI_Aint first = this->_first_buf[enqueuer_rank];
+    const MPI_Aint nreads =
+        std::min(this->_batch_size, this->_last_buf[enqueuer_rank] - first);
+    const MPI_Aint start = first % this->_capacity;
+    const MPI_Aint head_size = std::min(nreads, this->_capacity - start);
+    batch_aread_async(
+        this->_cached_data[enqueuer_rank], head_size,
+        this->_data_region.disp(start_offset(enqueuer_rank) + start),
+        this->_dequeuer_rank, this->_win);
+    if (head_size < nreads) {
+      batch_aread_async(this->_cached_data[enqueuer_rank] + head_size,
+                        nreads - head_size,
+                        this->_data_region.disp(start_offset(enqueuer_rank)),
+                        this->_dequeuer_rank, this->_win);
+    }
+    flush(this->_dequeuer_rank, this->_win);
+    this->_cached_size[enqueuer_rank] = nreads;
+    this->_cached_offset[enqueuer_rank] = 0;
+  }
 
 public:
   HostedBoundedSpsc(MPI_Aint capacity, MPI_Aint dequeuer_rank, MPI_Comm comm,
-                    MPI_Aint batch_size = 10)
+                    MPI_Aint batch_size = 10,
+                    LastPublication publication = LastPublication::EVERY_N,
+                    MPI_Aint publication_interval = 10)
       : _dequeuer_rank{dequeuer_rank}, _capacity{capacity}, _first_buf{0},
-        _last_buf{0}, _batch_size{batch_size} {
+        _last_buf{0}, _batch_size{batch_size},
+        _publication{publication},
+        _publication_interval{std::max<MPI_Aint>(publication_interval, 1)} {
     MPI_Comm_rank(comm, &this->_self_rank);
     MPI_Comm_size(comm, &this->_comm_size);
     _first_buf = std::vector<MPI_Aint>(this->_comm_size);
@@ -44,86 +110,78 @@ public:
     MPI_Info_create(&this->_info);
     MPI_Info_set(this->_info, "same_disp_unit", "true");
     MPI_Info_set(this->_info, "accumulate_ordering", "none");
-
-    if (this->_self_rank == dequeuer_rank) {
-      MPI_Win_allocate(capacity * sizeof(data_t) * this->_comm_size,
-                       sizeof(data_t), this->_info, comm, &this->_data_ptr,
-                       &this->_data_win);
-      MPI_Win_allocate(this->_comm_size * sizeof(MPI_Aint), sizeof(MPI_Aint),
-                       this->_info, comm, &this->_first_ptr, &this->_first_win);
-      MPI_Win_allocate(this->_comm_size * sizeof(MPI_Aint), sizeof(MPI_Aint),
-                       this->_info, comm, &this->_last_ptr, &this->_last_win);
-      MPI_Win_allocate(0, sizeof(MPI_Aint), this->_info, comm,
-                       &this->_enqueuer_local_last_ptr,
-                       &this->_enqueuer_local_last_win);
+    MPI_Info_set(this->_info, "which_accumulate_ops", "replace,no_op");
+
+    const bool is_dequeuer = this->_self_rank == dequeuer_rank;
+    WindowLayout layout;
+    this->_enqueuer_local_last_region = layout.add<MPI_Aint>(1, true);
+    this->_data_region =
+        layout.add<data_t>(capacity * this->_comm_size, is_dequeuer);
+    this->_first_region = layout.add<MPI_Aint>(this->_comm_size, is_dequeuer);
+    this->_last_region = layout.add<MPI_Aint>(this->_comm_size, is_dequeuer);
+    void *base = layout.allocate(this->_info, comm, &this->_win);
+    this->_local_stores = win_unified(this->_win);
+    this->_enqueuer_local_last_ptr =
+        this->_enqueuer_local_last_region.ptr(base);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_win);
+    *this->_enqueuer_local_last_ptr = 0;
+
+    if (is_dequeuer) {
+      this->_data_ptr = this->_data_region.ptr(base);
+      this->_first_ptr = this->_first_region.ptr(base);
+      this->_last_ptr = this->_last_region.ptr(base);
       this->_cached_data =
           (data_t **)malloc(sizeof(data_t *) * this->_comm_size);
       this->_cached_size =
           (MPI_Aint *)malloc(sizeof(MPI_Aint) * this->_comm_size);
+      this->_cached_offset =
+          (MPI_Aint *)malloc(sizeof(MPI_Aint) * this->_comm_size);
       for (int i = 0; i < this->_comm_size; ++i) {
         this->_cached_data[i] =
             (data_t *)malloc(sizeof(data_t) * this->_batch_size);
         this->_cached_size[i] = 0;
+        this->_cached_offset[i] = 0;
       }
-
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _first_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _last_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _data_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _enqueuer_local_last_win);
       for (int i = 0; i < this->_comm_size; ++i) {
         this->_first_ptr[i] = 0;
         this->_last_ptr[i] = 0;
       }
-    } else {
-      MPI_Win_allocate(0, sizeof(data_t), this->_info, comm, &this->_data_ptr,
-                       &this->_data_win);
-      MPI_Win_allocate(0, sizeof(MPI_Aint), this->_info, comm,
-                       &this->_first_ptr, &this->_first_win);
-      MPI_Win_allocate(0, sizeof(MPI_Aint), this->_info, comm, &this->_last_ptr,
-                       &this->_last_win);
-      MPI_Win_allocate(sizeof(MPI_Aint), sizeof(MPI_Aint), this->_info, comm,
-                       &this->_enqueuer_local_last_ptr,
-                       &this->_enqueuer_local_last_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _first_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _last_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _data_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _enqueuer_local_last_win);
-      *_enqueuer_local_last_ptr = 0;
     }
-    MPI_Win_flush_all(this->_data_win);
-    MPI_Win_flush_all(this->_first_win);
-    MPI_Win_flush_all(this->_last_win);
-    MPI_Win_flush_all(this->_enqueuer_local_last_win);
+    MPI_Win_flush_all(this->_win);
     MPI_Barrier(comm);
-    MPI_Win_flush_all(this->_data_win);
-    MPI_Win_flush_all(this->_first_win);
-    MPI_Win_flush_all(this->_last_win);
-    MPI_Win_flush_all(this->_enqueuer_local_last_win);
+    MPI_Win_flush_all(this->_win);
   }
 
   HostedBoundedSpsc(HostedBoundedSpsc &&other) noexcept
       : _self_rank(other._self_rank), _dequeuer_rank(other._dequeuer_rank),
-        _capacity(other._capacity), _data_win(other._data_win),
-        _data_ptr(other._data_ptr), _first_win(other._first_win),
-        _first_ptr(other._first_ptr), _first_buf(std::move(other._first_buf)),
-        _last_win(other._last_win), _last_ptr(other._last_ptr),
-        _enqueuer_local_last_win(other._enqueuer_local_last_win),
+        _capacity(other._capacity), _win(other._win),
+        _local_stores(other._local_stores), _data_region(other._data_region),
+        _data_ptr(other._data_ptr),
+        _first_region(other._first_region), _first_ptr(other._first_ptr),
+        _first_buf(std::move(other._first_buf)),
+        _last_region(other._last_region), _last_ptr(other._last_ptr),
+        _enqueuer_local_last_region(other._enqueuer_local_last_region),
         _enqueuer_local_last_ptr(other._enqueuer_local_last_ptr),
         _last_buf(std::move(other._last_buf)), _info(other._info),
         _comm_size(other._comm_size), _batch_size(other._batch_size),
-        _cached_data(other._cached_data), _cached_size(other._cached_size) {
-
-    other._data_win = MPI_WIN_NULL;
+        _cached_data(other._cached_data), _cached_size(other._cached_size),
+        _cached_offset(other._cached_offset),
+        _publication(other._publication),
+        _publication_interval(other._publication_interval),
+        _last_published(other._last_published),
+        _last_publication_time(other._last_publication_time),
+        _publication_stats(other._publication_stats),
+        _stats(other._stats) {
+
+    other._win = MPI_WIN_NULL;
     other._data_ptr = nullptr;
-    other._first_win = MPI_WIN_NULL;
     other._first_ptr = nullptr;
-    other._last_win = MPI_WIN_NULL;
     other._last_ptr = nullptr;
-    other._enqueuer_local_last_win = MPI_WIN_NULL;
     other._enqueuer_local_last_ptr = nullptr;
     other._info = MPI_INFO_NULL;
     other._cached_data = nullptr;
     other._cached_size = nullptr;
+    other._cached_offset = nullptr;
   }
 
   HostedBoundedSpsc(const HostedBoundedSpsc &) = delete;
@@ -131,15 +189,9 @@ public:
   HostedBoundedSpsc &operator=(HostedBoundedSpsc &&) = delete;
 
   ~HostedBoundedSpsc() {
-    if (_data_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_first_win);
-      MPI_Win_unlock_all(_last_win);
-      MPI_Win_unlock_all(_enqueuer_local_last_win);
-      MPI_Win_unlock_all(_data_win);
-      MPI_Win_free(&this->_data_win);
-      MPI_Win_free(&this->_first_win);
-      MPI_Win_free(&this->_last_win);
-      MPI_Win_free(&this->_enqueuer_local_last_win);
+    if (_win != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(_win);
+      win_free(&this->_win);
     }
 
     if (_info != MPI_INFO_NULL) {
@@ -153,30 +205,45 @@ public:
       }
       free(this->_cached_data);
       free(this->_cached_size);
+      free(this->_cached_offset);
     }
   }
 
   int start_offset(int rank) { return this->_capacity * rank; }
 
   bool enqueue(const data_t &data) {
+    StatsScope stats_scope(this->_stats);
     MPI_Aint new_last = this->_last_buf[this->_self_rank] + 1;
 
     if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
-      aread_sync(&this->_first_buf[this->_self_rank], this->_self_rank,
-                 this->_dequeuer_rank, this->_first_win);
+      stats_count_cache_miss();
+      aread_sync(&this->_first_buf[this->_self_rank],
+                 this->_first_region.disp(this->_self_rank),
+                 this->_dequeuer_rank, this->_win);
       if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
         return false;
       }
+    } else {
+      stats_count_cache_hit();
     }
 
     awrite_sync(&data,
-                start_offset(this->_self_rank) +
-                    this->_last_buf[this->_self_rank] % this->_capacity,
-                this->_dequeuer_rank, this->_data_win);
-    awrite_sync(&new_last, 0, this->_self_rank, this->_enqueuer_local_last_win);
-    if (new_last % 10 == 0) {
-      awrite_sync(&new_last, this->_self_rank, this->_dequeuer_rank,
-                  this->_last_win);
+                this->_data_region.disp(
+                    start_offset(this->_self_rank) +
+                    this->_last_buf[this->_self_rank] % this->_capacity),
+                this->_dequeuer_rank, this->_win);
+    if (this->_local_stores) {
+      __atomic_store_n(this->_enqueuer_local_last_ptr, new_last,
+                       __ATOMIC_RELEASE);
+      MPI_Win_sync(this->_win);
+    } else {
+      awrite_sync(&new_last, this->_enqueuer_local_last_region.disp(),
+                  this->_self_rank, this->_win);
+    }
+    if (this->_should_publish(new_last)) {
+      awrite_sync(&new_last, this->_last_region.disp(this->_self_rank),
+                  this->_dequeuer_rank, this->_win);
+      this->_mark_published(new_last);
     }
     this->_last_buf[this->_self_rank] = new_last;
 
@@ -184,120 +251,174 @@ public:
   }
 
   bool enqueue(const std::vector<data_t> &data) {
+    StatsScope stats_scope(this->_stats);
     MPI_Aint new_last = this->_last_buf[this->_self_rank] + data.size();
 
     if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
-      aread_sync(&this->_first_buf[this->_self_rank], this->_self_rank,
-                 this->_dequeuer_rank, this->_first_win);
+      stats_count_cache_miss();
+      aread_sync(&this->_first_buf[this->_self_rank],
+                 this->_first_region.disp(this->_self_rank),
+                 this->_dequeuer_rank, this->_win);
       if (new_last - this->_first_buf[this->_self_rank] > this->_capacity) {
         return false;
       }
+    } else {
+      stats_count_cache_hit();
     }
 
-    const uint64_t size = data.size();
-    for (int i = 0; i < size; ++i) {
-      const uint64_t disp =
-          (this->_last_buf[this->_self_rank] + i) % this->_capacity;
-      awrite_async(data.data() + i, start_offset(this->_self_rank) + disp,
-                   this->_dequeuer_rank, this->_data_win);
+    // At most two contiguous segments, split at the wraparound
+    const MPI_Aint size = data.size();
+    const MPI_Aint start = this->_last_buf[this->_self_rank] % this->_capacity;
+    const MPI_Aint head_size = std::min(size, this->_capacity - start);
+    batch_awrite_async(
+        data.data(), head_size,
+        this->_data_region.disp(start_offset(this->_self_rank) + start),
+        this->_dequeuer_rank, this->_win);
+    if (head_size < size) {
+      batch_awrite_async(
+          data.data() + head_size, size - head_size,
+          this->_data_region.disp(start_offset(this->_self_rank)),
+          this->_dequeuer_rank, this->_win);
+    }
+    flush(this->_dequeuer_rank, this->_win);
+    if (this->_local_stores) {
+      __atomic_store_n(this->_enqueuer_local_last_ptr, new_last,
+                       __ATOMIC_RELEASE);
+      MPI_Win_sync(this->_win);
+      awrite_sync(&new_last, this->_last_region.disp(this->_self_rank),
+                  this->_dequeuer_rank, this->_win);
+    } else {
+      awrite_async(&new_last, this->_enqueuer_local_last_region.disp(),
+                   this->_self_rank, this->_win);
+      awrite_sync(&new_last, this->_last_region.disp(this->_self_rank),
+                  this->_dequeuer_rank, this->_win);
+      flush(this->_self_rank, this->_win);
     }
-    flush(this->_dequeuer_rank, this->_data_win);
-    awrite_sync(&new_last, this->_self_rank, this->_dequeuer_rank,
-                this->_last_win);
+    this->_mark_published(new_last);
     this->_last_buf[this->_self_rank] = new_last;
 
     return true;
   }
 
   bool e_read_front(data_t *output) {
+    StatsScope stats_scope(this->_stats);
     if (this->_first_buf[this->_self_rank] >=
         this->_last_buf[this->_self_rank]) {
       return false;
     }
-    aread_sync(&this->_first_buf[this->_self_rank], this->_self_rank,
-               this->_dequeuer_rank, this->_first_win);
-    if (this->_first_buf >= this->_last_buf) {
+    aread_sync(&this->_first_buf[this->_self_rank],
+               this->_first_region.disp(this->_self_rank), this->_dequeuer_rank,
+               this->_win);
+    if (this->_first_buf[this->_self_rank] >=
+        this->_last_buf[this->_self_rank]) {
       return false;
     }
 
     data_t data;
     aread_sync(&data,
-               start_offset(this->_self_rank) +
-                   this->_first_buf[this->_self_rank] % this->_capacity,
-               this->_dequeuer_rank, this->_data_win);
+               this->_data_region.disp(
+                   start_offset(this->_self_rank) +
+                   this->_first_buf[this->_self_rank] % this->_capacity),
+               this->_dequeuer_rank, this->_win);
 
     *output = data;
     return true;
   }
 
   bool dequeue(data_t *output, int enqueuer_rank) {
+    StatsScope stats_scope(this->_stats);
     MPI_Aint new_first = this->_first_buf[enqueuer_rank] + 1;
     if (new_first > this->_last_buf[enqueuer_rank]) {
-      aread_sync(&this->_last_buf[enqueuer_rank], enqueuer_rank,
-                 this->_self_rank, this->_last_win);
+      stats_count_cache_miss();
+      aread_sync(&this->_last_buf[enqueuer_rank],
+                 this->_last_region.disp(enqueuer_rank), this->_self_rank,
+                 this->_win);
+      ++this->_publication_stats.last_reads;
       if (new_first > this->_last_buf[enqueuer_rank]) {
-        aread_sync(&this->_last_buf[enqueuer_rank], 0, enqueuer_rank,
-                   this->_enqueuer_local_last_win);
+        aread_sync(&this->_last_buf[enqueuer_rank],
+                   this->_enqueuer_local_last_region.disp(), enqueuer_rank,
+                   this->_win);
+        ++this->_publication_stats.fallback_reads;
         if (new_first > this->_last_buf[enqueuer_rank]) {
+          ++this->_publication_stats.empty_fallback_reads;
           return false;
         }
       }
+    } else {
+      stats_count_cache_hit();
     }
 
-    if (this->_cached_size[enqueuer_rank] > 0) {
-      *output = this->_cached_data[enqueuer_rank]
-                                  [this->_cached_size[enqueuer_rank] - 1];
-      --this->_cached_size[enqueuer_rank];
+    if (this->_cached_size[enqueuer_rank] <= 0) {
+      stats_count_cache_miss();
+      this->_refill_cache(enqueuer_rank);
     } else {
-      aread_async(output,
-                  start_offset(enqueuer_rank) +
-                      this->_first_buf[enqueuer_rank] % this->_capacity,
-                  this->_dequeuer_rank, this->_data_win);
-      int nreads = std::min(this->_batch_size,
-                            this->_last_buf[enqueuer_rank] - new_first);
-      this->_cached_size[enqueuer_rank] = nreads;
-      for (int i = 0; i < nreads; ++i) {
-        aread_async(this->_cached_data[enqueuer_rank] + nreads - i - 1,
-                    start_offset(enqueuer_rank) +
-                        (new_first + i) % this->_capacity,
-                    this->_dequeuer_rank, this->_data_win);
-      }
-      flush(this->_dequeuer_rank, this->_data_win);
+      stats_count_cache_hit();
     }
-    awrite_sync(&new_first, enqueuer_rank, this->_self_rank, this->_first_win);
+    *output = this->_cached_data[enqueuer_rank]
+                                [this->_cached_offset[enqueuer_rank]];
+    ++this->_cached_offset[enqueuer_rank];
+    --this->_cached_size[enqueuer_rank];
+    awrite_sync(&new_first, this->_first_region.disp(enqueuer_rank),
+                this->_self_rank, this->_win);
     this->_first_buf[enqueuer_rank] = new_first;
 
     return true;
   }
 
   bool d_read_front(data_t *output, int enqueuer_rank) {
+    StatsScope stats_scope(this->_stats);
     if (this->_first_buf[enqueuer_rank] >= this->_last_buf[enqueuer_rank]) {
-      aread_sync(&this->_last_buf[enqueuer_rank], enqueuer_rank,
-                 this->_self_rank, this->_last_win);
+      stats_count_cache_miss();
+      aread_sync(&this->_last_buf[enqueuer_rank],
+                 this->_last_region.disp(enqueuer_rank), this->_self_rank,
+                 this->_win);
+      ++this->_publication_stats.last_reads;
       if (this->_first_buf[enqueuer_rank] >= this->_last_buf[enqueuer_rank]) {
-        aread_sync(&this->_last_buf[enqueuer_rank], 0, enqueuer_rank,
-                   this->_enqueuer_local_last_win);
+        aread_sync(&this->_last_buf[enqueuer_rank],
+                   this->_enqueuer_local_last_region.disp(), enqueuer_rank,
+                   this->_win);
+        ++this->_publication_stats.fallback_reads;
         if (this->_first_buf[enqueuer_rank] >= this->_last_buf[enqueuer_rank]) {
+          ++this->_publication_stats.empty_fallback_reads;
           return false;
         }
       }
+    } else {
+      stats_count_cache_hit();
     }
 
     if (this->_cached_size[enqueuer_rank] <= 0) {
-      int nreads =
-          std::min(this->_batch_size, this->_last_buf[enqueuer_rank] -
-                                          this->_first_buf[enqueuer_rank]);
-      this->_cached_size[enqueuer_rank] = nreads;
-      for (int i = 0; i < nreads; ++i) {
-        aread_async(this->_cached_data[enqueuer_rank] + nreads - i - 1,
-                    start_offset(enqueuer_rank) +
-                        (this->_first_buf[enqueuer_rank] + i) % this->_capacity,
-                    this->_dequeuer_rank, this->_data_win);
-      }
-      flush(this->_dequeuer_rank, this->_data_win);
+      stats_count_cache_miss();
+      this->_refill_cache(enqueuer_rank);
+    } else {
+      stats_count_cache_hit();
     }
     *output = this->_cached_data[enqueuer_rank]
-                                [this->_cached_size[enqueuer_rank] - 1];
+                                [this->_cached_offset[enqueuer_rank]];
     return true;
   }
+
+  // Empties the rings: reinitializes the indexes this rank hosts and its
+  // cached ones. It does not synchronize; the owning queue's reset() does.
+  void reset() {
+    *this->_enqueuer_local_last_ptr = 0;
+    std::fill(this->_first_buf.begin(), this->_first_buf.end(), 0);
+    std::fill(this->_last_buf.begin(), this->_last_buf.end(), 0);
+    this->_last_published = 0;
+    this->_last_publication_time = 0;
+    if (this->_self_rank == this->_dequeuer_rank) {
+      for (int i = 0; i < this->_comm_size; ++i) {
+        this->_first_ptr[i] = 0;
+        this->_last_ptr[i] = 0;
+        this->_cached_size[i] = 0;
+        this->_cached_offset[i] = 0;
+      }
+    }
+  }
+
+  PublicationStats publication_stats() const {
+    return this->_publication_stats;
+  }
+
+  queue_stats_t stats() const { return this->_stats; }
 };
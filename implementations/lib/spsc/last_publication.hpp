@@ -0,0 +1,24 @@
+#pragma once
+
+// When a bounded Spsc enqueuer pushes its last index to the copy hosted on
+// the dequeuer. Whenever the published copy looks empty, the dequeuer falls
+// back to a remote read of the enqueuer-local last index.
+enum class LastPublication {
+  // Every `interval` items; a non-positive interval counts as 1.
+  EVERY_N,
+  // When at least `interval` microseconds have passed since the last
+  // publication.
+  TIMED,
+  // When the dequeuer may have drained everything published so far, judged
+  // from the enqueuer's cached first index.
+  ON_EMPTY,
+};
+
+struct PublicationStats {
+  // Enqueuer side
+  unsigned long long publications;
+  // Dequeuer side
+  unsigned long long last_reads;
+  unsigned long long fallback_reads;
+  unsigned long long empty_fallback_reads;
+};
@@ -0,0 +1,285 @@
+#pragma once
+
+#include "../queue_arena.hpp"
+#include "../stats.hpp"
+#include "../vector_fifo.hpp"
+#include "bounded_spsc.hpp"
+#include "last_publication.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mpi.h>
+#include <utility>
+#include <vector>
+
+// A bounded Spsc of timestamped items that stores each enqueue as one record:
+// a header with the timestamp and item count, followed by the raw items. A
+// batch thus carries one timestamp instead of one per item. The underlying
+// ring is made of word-sized cells: the widest word of at most 8 bytes that
+// divides sizeof(T), and no less aligned than T, so that a header costs
+// little next to small and large items alike and items stay aligned.
+//
+// The dequeuer consumes a record's header as soon as it reads it and keeps
+// the record's timestamp and remaining count; the enqueuer maps its first
+// index to the timestamp of the record it falls in, from the records it wrote.
+template <typename T, typename timestamp_t> class RecordSpsc {
+private:
+  constexpr static size_t CELL_SIZE = std::max(
+      alignof(T), sizeof(T) % 8 == 0   ? (size_t)8
+                  : sizeof(T) % 4 == 0 ? (size_t)4
+                  : sizeof(T) % 2 == 0 ? (size_t)2
+                                       : (size_t)1);
+
+  struct alignas(CELL_SIZE) cell_t {
+    unsigned char bytes[CELL_SIZE];
+  };
+
+  typedef uint32_t count_t;
+  constexpr static MPI_Aint HEADER_BYTES =
+      sizeof(timestamp_t) + sizeof(count_t);
+  constexpr static MPI_Aint HEADER_CELLS =
+      (HEADER_BYTES + CELL_SIZE - 1) / CELL_SIZE;
+  constexpr static MPI_Aint ITEM_CELLS = sizeof(T) / CELL_SIZE;
+  // Cells of a single-item record, which ring capacity and batch sizes given
+  // in items are scaled by.
+  constexpr static MPI_Aint RECORD_CELLS = HEADER_CELLS + ITEM_CELLS;
+
+  Spsc<cell_t> _spsc;
+
+  // Enqueuer side: the end index and timestamp of each record that may still
+  // be in the ring, oldest first, and the end index of the last one.
+  VectorFifo<std::pair<MPI_Aint, timestamp_t>> _records;
+  MPI_Aint _last = 0;
+
+  // Dequeuer side, per enqueuer: the timestamp and number of items left of
+  // the record whose header was consumed.
+  std::vector<timestamp_t> _front_timestamp;
+  std::vector<MPI_Aint> _front_remaining;
+
+  std::vector<cell_t> _cells;
+
+  static MPI_Aint _scaled_interval(LastPublication publication,
+                                   MPI_Aint publication_interval) {
+    if (publication == LastPublication::EVERY_N) {
+      return publication_interval * RECORD_CELLS;
+    }
+    return publication_interval;
+  }
+
+  static void _encode_header(cell_t *cells, timestamp_t timestamp,
+                             count_t count) {
+    unsigned char *header = reinterpret_cast<unsigned char *>(cells);
+    std::memcpy(header, &timestamp, sizeof(timestamp_t));
+    std::memcpy(header + sizeof(timestamp_t), &count, sizeof(count_t));
+  }
+
+  void _record_enqueued(MPI_Aint cells, timestamp_t timestamp) {
+    this->_last += cells;
+    this->_records.push_back(std::make_pair(this->_last, timestamp));
+  }
+
+  bool _enqueue_cells(timestamp_t timestamp) {
+    if (!this->_spsc.enqueue(this->_cells.data(), this->_cells.size())) {
+      return false;
+    }
+    this->_record_enqueued(this->_cells.size(), timestamp);
+    return true;
+  }
+
+  // Makes sure the front record of `enqueuer_rank` has items left, consuming
+  // the next header if needed.
+  bool _d_open_record(int enqueuer_rank) {
+    if (this->_front_remaining[enqueuer_rank] > 0) {
+      return true;
+    }
+    cell_t header[HEADER_CELLS];
+    if (!this->_spsc.dequeue(header, HEADER_CELLS, enqueuer_rank)) {
+      return false;
+    }
+    const unsigned char *bytes = reinterpret_cast<unsigned char *>(header);
+    timestamp_t timestamp;
+    count_t count;
+    std::memcpy(&timestamp, bytes, sizeof(timestamp_t));
+    std::memcpy(&count, bytes + sizeof(timestamp_t), sizeof(count_t));
+    this->_front_timestamp[enqueuer_rank] = timestamp;
+    this->_front_remaining[enqueuer_rank] = count;
+    return true;
+  }
+
+  // Takes `count` items, at most the remaining ones, of the open record.
+  bool _d_take(T *output, MPI_Aint count, int enqueuer_rank) {
+    this->_cells.resize(count * ITEM_CELLS);
+    if (!this->_spsc.dequeue(this->_cells.data(), count * ITEM_CELLS,
+                             enqueuer_rank)) {
+      return false;
+    }
+    std::memcpy(output, this->_cells.data(), count * sizeof(T));
+    this->_front_remaining[enqueuer_rank] -= count;
+    return true;
+  }
+
+  void _init_dequeuer_state(int comm_size) {
+    this->_front_timestamp = std::vector<timestamp_t>(comm_size);
+    this->_front_remaining = std::vector<MPI_Aint>(comm_size, 0);
+  }
+
+public:
+  RecordSpsc(MPI_Aint capacity, MPI_Aint dequeuer_rank, MPI_Comm comm,
+             MPI_Aint batch_size = 10,
+             LastPublication publication = LastPublication::EVERY_N,
+             MPI_Aint publication_interval = 10)
+      : _spsc{capacity * RECORD_CELLS, dequeuer_rank, comm,
+              batch_size * RECORD_CELLS, publication,
+              _scaled_interval(publication, publication_interval)} {
+    int comm_size;
+    MPI_Comm_size(comm, &comm_size);
+    this->_init_dequeuer_state(comm_size);
+  }
+
+  // Carves the queue from `arena`; see QueueArena for the protocol.
+  RecordSpsc(MPI_Aint capacity, MPI_Aint dequeuer_rank, QueueArena &arena,
+             MPI_Aint batch_size = 10,
+             LastPublication publication = LastPublication::EVERY_N,
+             MPI_Aint publication_interval = 10)
+      : _spsc{capacity * RECORD_CELLS, dequeuer_rank, arena,
+              batch_size * RECORD_CELLS, publication,
+              _scaled_interval(publication, publication_interval)} {
+    int comm_size;
+    MPI_Comm_size(arena.comm(), &comm_size);
+    this->_init_dequeuer_state(comm_size);
+  }
+
+  // Arena space one queue takes on a communicator of `comm_size` ranks.
+  static MPI_Aint arena_size(MPI_Aint capacity, int comm_size) {
+    return Spsc<cell_t>::arena_size(capacity * RECORD_CELLS, comm_size);
+  }
+
+  RecordSpsc(RecordSpsc &&other) noexcept
+      : _spsc(std::move(other._spsc)), _records(std::move(other._records)),
+        _last(other._last),
+        _front_timestamp(std::move(other._front_timestamp)),
+        _front_remaining(std::move(other._front_remaining)),
+        _cells(std::move(other._cells)) {}
+
+  RecordSpsc(const RecordSpsc &) = delete;
+  RecordSpsc &operator=(const RecordSpsc &) = delete;
+  RecordSpsc &operator=(RecordSpsc &&) = delete;
+
+  bool enqueue(const T &data, timestamp_t timestamp) {
+    this->_cells.resize(RECORD_CELLS);
+    _encode_header(this->_cells.data(), timestamp, 1);
+    std::memcpy(this->_cells.data() + HEADER_CELLS, &data, sizeof(T));
+    return this->_enqueue_cells(timestamp);
+  }
+
+  bool enqueue(const std::vector<T> &data, timestamp_t timestamp) {
+    return this->enqueue(data.data(), data.size(), timestamp);
+  }
+
+  // The record is assembled in a scratch buffer kept across calls, so a
+  // batch allocates only when it is larger than every earlier one.
+  bool enqueue(const T *data, MPI_Aint size, timestamp_t timestamp) {
+    if (size == 0) {
+      return true;
+    }
+    if (size > ~((count_t)0)) {
+      return false;
+    }
+    this->_cells.resize(HEADER_CELLS + size * ITEM_CELLS);
+    _encode_header(this->_cells.data(), timestamp, size);
+    std::memcpy(this->_cells.data() + HEADER_CELLS, data, size * sizeof(T));
+    return this->_enqueue_cells(timestamp);
+  }
+
+  // Room for `size` items to construct in place, see reserve().
+  struct reservation_t {
+    T *data;
+    MPI_Aint size;
+    typename Spsc<cell_t>::reservation_t cells;
+  };
+
+  // Reserves a record of `size` > 0 items and returns where to construct
+  // them, directly in the ring when Spsc::reserve allows it. `data` is
+  // nullptr if the ring is full.
+  reservation_t reserve(MPI_Aint size) {
+    if (size <= 0 || size > ~((count_t)0)) {
+      return reservation_t{nullptr, 0, {nullptr, 0}};
+    }
+    typename Spsc<cell_t>::reservation_t cells =
+        this->_spsc.reserve(HEADER_CELLS + size * ITEM_CELLS);
+    if (cells.data == nullptr) {
+      return reservation_t{nullptr, 0, cells};
+    }
+    return reservation_t{reinterpret_cast<T *>(cells.data + HEADER_CELLS), size,
+                         cells};
+  }
+
+  // Stamps the reserved record with `timestamp` and publishes it.
+  void commit(const reservation_t &reservation, timestamp_t timestamp) {
+    _encode_header(reservation.cells.data, timestamp, reservation.size);
+    this->_spsc.commit(reservation.cells);
+    this->_record_enqueued(reservation.cells.size, timestamp);
+  }
+
+  // Timestamp of the enqueuer's front item.
+  bool e_read_front(timestamp_t *timestamp) {
+    MPI_Aint first;
+    if (!this->_spsc.e_read_first(&first)) {
+      this->_records.clear();
+      return false;
+    }
+    while (this->_records.front().first <= first) {
+      this->_records.pop_front();
+    }
+    *timestamp = this->_records.front().second;
+    return true;
+  }
+
+  // Timestamp of the front item of `enqueuer_rank`.
+  bool d_read_front(timestamp_t *timestamp, int enqueuer_rank) {
+    if (!this->_d_open_record(enqueuer_rank)) {
+      return false;
+    }
+    *timestamp = this->_front_timestamp[enqueuer_rank];
+    return true;
+  }
+
+  bool dequeue(T *output, int enqueuer_rank) {
+    if (!this->_d_open_record(enqueuer_rank)) {
+      return false;
+    }
+    return this->_d_take(output, 1, enqueuer_rank);
+  }
+
+  // Appends up to `max` items of the front record of `enqueuer_rank`, which
+  // all share its timestamp, to `output`; returns how many.
+  MPI_Aint dequeue(std::vector<T> &output, MPI_Aint max, int enqueuer_rank) {
+    if (max <= 0 || !this->_d_open_record(enqueuer_rank)) {
+      return 0;
+    }
+    const MPI_Aint count =
+        std::min(max, this->_front_remaining[enqueuer_rank]);
+    const size_t initial_size = output.size();
+    output.resize(initial_size + count);
+    if (!this->_d_take(output.data() + initial_size, count, enqueuer_rank)) {
+      output.resize(initial_size);
+      return 0;
+    }
+    return count;
+  }
+
+  // Empties the ring and the record bookkeeping. It does not synchronize;
+  // the owning queue's reset() does.
+  void reset() {
+    this->_spsc.reset();
+    this->_records.clear();
+    this->_last = 0;
+    std::fill(this->_front_remaining.begin(), this->_front_remaining.end(), 0);
+  }
+
+  PublicationStats publication_stats() const {
+    return this->_spsc.publication_stats();
+  }
+
+  queue_stats_t stats() const { return this->_spsc.stats(); }
+};
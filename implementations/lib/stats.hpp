@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mpi.h>
+#include <string>
+
+// Operation counts of a queue, to see where its round-trips go. Counting is
+// only compiled in with QUEUE_STATS defined; otherwise every hook below is
+// empty and a queue's stats() stays zero.
+//
+// An operation is charged to the queue whose public method issued it, through
+// the StatsScope that method opens, so a queue's counts include those of the
+// counter and SPSCs it is built from. Accesses served by the fast paths of
+// node_local.hpp are not round-trips and are not counted.
+struct queue_stats_t {
+  uint64_t gets = 0;
+  uint64_t puts = 0;
+  uint64_t fetch_and_adds = 0;
+  uint64_t compare_and_swaps = 0;
+  uint64_t flushes = 0;
+  uint64_t bytes = 0;
+  // CASes that found another value than the expected one.
+  uint64_t cas_failures = 0;
+  // SPSC lookups of a cached index or cached items that could, or could not,
+  // be answered without reading the remote copy first.
+  uint64_t cache_hits = 0;
+  uint64_t cache_misses = 0;
+  uint64_t empty_dequeues = 0;
+
+  queue_stats_t &operator+=(const queue_stats_t &other) {
+    this->gets += other.gets;
+    this->puts += other.puts;
+    this->fetch_and_adds += other.fetch_and_adds;
+    this->compare_and_swaps += other.compare_and_swaps;
+    this->flushes += other.flushes;
+    this->bytes += other.bytes;
+    this->cas_failures += other.cas_failures;
+    this->cache_hits += other.cache_hits;
+    this->cache_misses += other.cache_misses;
+    this->empty_dequeues += other.empty_dequeues;
+    return *this;
+  }
+};
+
+constexpr bool stats_enabled() {
+#ifdef QUEUE_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+inline queue_stats_t *&current_stats() {
+  static thread_local queue_stats_t *stats = nullptr;
+  return stats;
+}
+
+// Charges the operations issued until it goes out of scope to `stats`,
+// unless an enclosing scope already charges them to another queue.
+class StatsScope {
+private:
+  queue_stats_t *_previous = nullptr;
+
+public:
+  explicit StatsScope(queue_stats_t &stats) {
+    if constexpr (stats_enabled()) {
+      this->_previous = current_stats();
+      if (this->_previous == nullptr) {
+        current_stats() = &stats;
+      }
+    }
+  }
+
+  StatsScope(const StatsScope &) = delete;
+  StatsScope &operator=(const StatsScope &) = delete;
+
+  ~StatsScope() {
+    if constexpr (stats_enabled()) {
+      current_stats() = this->_previous;
+    }
+  }
+};
+
+inline void stats_add(uint64_t queue_stats_t::*field, uint64_t count) {
+  if constexpr (stats_enabled()) {
+    queue_stats_t *stats = current_stats();
+    if (stats != nullptr) {
+      stats->*field += count;
+    }
+  }
+}
+
+inline void stats_count_get(MPI_Aint bytes) {
+  stats_add(&queue_stats_t::gets, 1);
+  stats_add(&queue_stats_t::bytes, bytes);
+}
+
+inline void stats_count_put(MPI_Aint bytes) {
+  stats_add(&queue_stats_t::puts, 1);
+  stats_add(&queue_stats_t::bytes, bytes);
+}
+
+inline void stats_count_fetch_and_add(MPI_Aint bytes) {
+  stats_add(&queue_stats_t::fetch_and_adds, 1);
+  stats_add(&queue_stats_t::bytes, bytes);
+}
+
+inline void stats_count_compare_and_swap(MPI_Aint bytes) {
+  stats_add(&queue_stats_t::compare_and_swaps, 1);
+  stats_add(&queue_stats_t::bytes, bytes);
+}
+
+inline void stats_count_flush() { stats_add(&queue_stats_t::flushes, 1); }
+
+inline void stats_count_cas_failure() {
+  stats_add(&queue_stats_t::cas_failures, 1);
+}
+
+// Counts a failure if a completed CAS found another value than `expected`.
+template <typename T>
+inline void stats_count_cas_result(const T *expected, const T *result) {
+  if constexpr (stats_enabled()) {
+    if (std::memcmp(expected, result, sizeof(T)) != 0) {
+      stats_count_cas_failure();
+    }
+  }
+}
+
+inline void stats_count_cache_hit() {
+  stats_add(&queue_stats_t::cache_hits, 1);
+}
+
+inline void stats_count_cache_miss() {
+  stats_add(&queue_stats_t::cache_misses, 1);
+}
+
+inline void stats_count_empty_dequeue() {
+  stats_add(&queue_stats_t::empty_dequeues, 1);
+}
+
+// Collective over `comm` when counting is compiled in, a no-op otherwise.
+// Rank 0 prints every count summed over the ranks and its maximum on one rank.
+inline void report_queue_stats(const std::string &title,
+                               const queue_stats_t &stats, MPI_Comm comm) {
+  if constexpr (stats_enabled()) {
+    constexpr int FIELDS = 10;
+    const char *names[FIELDS] = {"Gets",
+                                 "Puts",
+                                 "FAAs",
+                                 "CASes",
+                                 "Flushes",
+                                 "Bytes",
+                                 "CAS failures",
+                                 "SPSC cache hits",
+                                 "SPSC cache misses",
+                                 "Empty dequeues"};
+    const uint64_t local[FIELDS] = {stats.gets,
+                                    stats.puts,
+                                    stats.fetch_and_adds,
+                                    stats.compare_and_swaps,
+                                    stats.flushes,
+                                    stats.bytes,
+                                    stats.cas_failures,
+                                    stats.cache_hits,
+                                    stats.cache_misses,
+                                    stats.empty_dequeues};
+    uint64_t sum[FIELDS];
+    uint64_t max[FIELDS];
+    MPI_Reduce(local, sum, FIELDS, MPI_UINT64_T, MPI_SUM, 0, comm);
+    MPI_Reduce(local, max, FIELDS, MPI_UINT64_T, MPI_MAX, 0, comm);
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0) {
+      printf("---- Stats - %s ----\n", title.c_str());
+      for (int i = 0; i < FIELDS; ++i) {
+        printf("%s: %llu (max per rank %llu)\n", names[i],
+               (unsigned long long)sum[i], (unsigned long long)max[i]);
+      }
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// A FIFO over a std::vector that keeps its storage once drained, so a steady
+// push/pop pattern stops allocating; std::deque allocates and frees a block
+// every few elements instead. Popped slots are reclaimed when the FIFO
+// empties, or by shifting the live elements down once they are the minority.
+template <typename T> class VectorFifo {
+private:
+  std::vector<T> _items;
+  size_t _head = 0;
+
+public:
+  VectorFifo() = default;
+
+  VectorFifo(VectorFifo &&other) noexcept
+      : _items(std::move(other._items)), _head(other._head) {
+    other._items.clear();
+    other._head = 0;
+  }
+
+  bool empty() const { return this->_head == this->_items.size(); }
+
+  size_t size() const { return this->_items.size() - this->_head; }
+
+  T &front() { return this->_items[this->_head]; }
+
+  void push_back(T item) {
+    if (this->_head > 0 && this->_head * 2 >= this->_items.size() &&
+        this->_items.size() == this->_items.capacity()) {
+      this->_items.erase(this->_items.begin(),
+                         this->_items.begin() + this->_head);
+      this->_head = 0;
+    }
+    this->_items.push_back(std::move(item));
+  }
+
+  void pop_front() {
+    this->_items[this->_head] = T();
+    ++this->_head;
+    if (this->_head == this->_items.size()) {
+      this->clear();
+    }
+  }
+
+  void clear() {
+    this->_items.clear();
+    this->_head = 0;
+  }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "node_local.hpp"
+#include <algorithm>
+#include <mpi.h>
+
+// Packs several typed regions into one window with a displacement unit of one
+// byte, so a queue registers a single window and one flush covers accesses to
+// all of its regions. Every rank declares the same regions in the same order,
+// which puts a region at the same displacement on every rank; a rank only
+// backs its window up to the end of the last region it hosts, so regions
+// hosted by fewer ranks should come last.
+class WindowLayout {
+public:
+  template <typename T> class Region {
+  private:
+    MPI_Aint _offset = 0;
+
+  public:
+    Region() = default;
+    explicit Region(MPI_Aint offset) : _offset{offset} {}
+
+    // Displacement of element `index`, to pass to the comm.hpp helpers.
+    MPI_Aint disp(MPI_Aint index = 0) const {
+      return this->_offset + index * (MPI_Aint)sizeof(T);
+    }
+
+    // Local address of the region in a window allocated by this layout.
+    T *ptr(void *base) const {
+      return reinterpret_cast<T *>(static_cast<char *>(base) + this->_offset);
+    }
+  };
+
+private:
+  MPI_Aint _extent;
+  MPI_Aint _local_size = 0;
+
+public:
+  // Regions are placed from `start` on, e.g. the free part of a QueueArena.
+  explicit WindowLayout(MPI_Aint start = 0) : _extent{start} {}
+
+  template <typename T> Region<T> add(MPI_Aint count, bool hosted) {
+    const MPI_Aint alignment = std::max<MPI_Aint>(alignof(T), 8);
+    const MPI_Aint offset =
+        (this->_extent + alignment - 1) / alignment * alignment;
+    this->_extent = offset + count * (MPI_Aint)sizeof(T);
+    if (hosted) {
+      this->_local_size = this->_extent;
+    }
+    return Region<T>{offset};
+  }
+
+  MPI_Aint extent() const { return this->_extent; }
+
+  MPI_Aint local_size() const { return this->_local_size; }
+
+  // Collective over `comm`; returns the local base address.
+  void *allocate(MPI_Info info, MPI_Comm comm, MPI_Win *win) const {
+    char *base;
+    win_allocate(this->_local_size, 1, info, comm, &base, win);
+    return base;
+  }
+};
@@ -3,13 +3,17 @@
 #include "../lib/comm.hpp"
 #include "../lib/distributed-counters/cs_faa.hpp"
 #include "../lib/spsc/bounded_spsc.hpp"
+#include "../lib/window_layout.hpp"
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <mpi.h>
 #include <vector>
 
-template <typename T> class LTNodeQueue {
+template <typename T, int Fanout = 2> class LTNodeQueue {
+  static_assert(Fanout >= 2, "LTNodeQueue: Fanout must be at least 2");
+
 private:
   struct alignas(8) tree_node_t {
     int32_t rank;
@@ -34,15 +38,20 @@ private:
 
   CsFaaCounter _counter;
 
-  MPI_Win _min_timestamp_win;
-  timestamp_t *_min_timestamp_ptr;
+  // The leaves' timestamps and the tree, both hosted by the dequeuer.
+  MPI_Win _win = MPI_WIN_NULL;
+
+  WindowLayout::Region<timestamp_t> _min_timestamp_region;
+  timestamp_t *_min_timestamp_ptr = nullptr;
 
-  MPI_Win _tree_win;
-  tree_node_t *_tree_ptr;
+  WindowLayout::Region<tree_node_t> _tree_region;
+  tree_node_t *_tree_ptr = nullptr;
   MPI_Info _info;
 
   Spsc<data_t> _spsc;
 
+  queue_stats_t _stats = {};
+
   int _get_number_of_processes() const {
     int number_processes;
     MPI_Comm_size(this->_comm, &number_processes);
@@ -50,85 +59,202 @@ private:
     return number_processes;
   }
 
-  int _get_tree_size() const { return 2 * this->_get_number_of_processes(); }
+  // The leaves (one per rank) follow the internal nodes, which are just
+  // enough to make every leaf the descendant of node 0.
+  int _get_internal_nodes_count() const {
+    const int number_processes = this->_get_number_of_processes();
+    return std::max(1, (number_processes - 1 + Fanout - 2) / (Fanout - 1));
+  }
+
+  int _get_tree_size() const {
+    return this->_get_internal_nodes_count() +
+           this->_get_number_of_processes();
+  }
 
   int _get_parent_index(int index) const {
     if (index == 0) {
       return -1;
     }
-    return (index - 1) / 2;
+    return (index - 1) / Fanout;
   }
 
   int _get_self_index() const {
-    return this->_get_number_of_processes() + this->_self_rank;
+    return this->_get_internal_nodes_count() + this->_self_rank;
   }
 
   int _get_enqueuer_index(int rank) const {
-    return this->_get_number_of_processes() + rank;
+    return this->_get_internal_nodes_count() + rank;
   }
 
-  std::vector<int> _get_children_indexes(int index) const {
-    int left_child = index * 2 + 1;
-    int right_child = index * 2 + 2;
-    std::vector<int> res;
-    if (left_child >= this->_get_tree_size()) {
-      return res;
-    }
-    res.push_back(left_child);
-    if (right_child >= this->_get_tree_size()) {
-      return res;
+  int _get_first_child_index(int index) const {
+    return index * Fanout + 1;
+  }
+
+  int _get_children_count(int index) const {
+    const int first_child = this->_get_first_child_index(index);
+    if (first_child >= this->_get_tree_size()) {
+      return 0;
     }
-    res.push_back(right_child);
-    return res;
+    return std::min(Fanout, this->_get_tree_size() - first_child);
   }
 
-  // Enqueuer's methods
+  // Tree methods, shared by the enqueuer (host = dequeuer) and the dequeuer
+  // (host = self)
 private:
-  void _e_propagate() {
+  // Completes `epoch` together with the children's timestamp reads.
+  tree_node_t _get_min_child(const tree_node_t *children, int children_count,
+                             uint32_t tag, MPI_Aint host, RmaEpoch &epoch) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
-    if (!this->_e_refresh_self_node()) {
-      this->_e_refresh_self_node();
+    timestamp_t child_timestamps[Fanout];
+    for (int i = 0; i < children_count; ++i) {
+      if (children[i].rank != DUMMY_RANK) {
+        epoch.aread(&child_timestamps[i],
+                    this->_min_timestamp_region.disp(children[i].rank), host,
+                    this->_win);
+      }
     }
-    int current_index = this->_get_self_index();
-    do {
-      current_index = this->_get_parent_index(current_index);
-      if (!this->_e_refresh(current_index)) {
-        this->_e_refresh(current_index);
+    epoch.flush();
+    uint32_t min_timestamp = MAX_TIMESTAMP;
+    int32_t min_timestamp_rank = DUMMY_RANK;
+    for (int i = 0; i < children_count; ++i) {
+      if (children[i].rank == DUMMY_RANK) {
+        continue;
       }
-    } while (current_index != 0);
+      if (child_timestamps[i].timestamp < min_timestamp) {
+        min_timestamp = child_timestamps[i].timestamp;
+        min_timestamp_rank = children[i].rank;
+      }
+    }
+    return {min_timestamp_rank, tag + 1};
   }
 
-  bool _e_refresh_self_node() {
+  tree_node_t _read_new_node(int index, int enqueuer_rank, uint32_t tag,
+                             MPI_Aint host) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
-    bool res;
-    int self_index = this->_get_self_index();
-    tree_node_t self_node;
-    timestamp_t min_timestamp;
-    aread_sync(&min_timestamp, this->_self_rank, this->_dequeuer_rank,
-               this->_min_timestamp_win);
+    if (index == this->_get_enqueuer_index(enqueuer_rank)) {
+      timestamp_t min_timestamp;
+      aread_sync(&min_timestamp,
+                 this->_min_timestamp_region.disp(enqueuer_rank), host,
+                 this->_win);
+      if (min_timestamp.timestamp == MAX_TIMESTAMP) {
+        return {DUMMY_RANK, tag + 1};
+      }
+      return {enqueuer_rank, tag + 1};
+    }
+    tree_node_t children[Fanout];
+    const int children_count = this->_get_children_count(index);
+    batch_aread_sync(
+        children, children_count,
+        this->_tree_region.disp(this->_get_first_child_index(index)), host,
+        this->_win);
+    RmaEpoch epoch;
+    return this->_get_min_child(children, children_count, tag, host, epoch);
+  }
 
-    aread_sync(&self_node, self_index, this->_dequeuer_rank, this->_tree_win);
-    if (min_timestamp.timestamp == MAX_TIMESTAMP) {
-      const tree_node_t new_node = {DUMMY_RANK, self_node.tag + 1};
-      tree_node_t result_node;
-      compare_and_swap_sync(&self_node, &new_node, &result_node, self_index,
-                            this->_dequeuer_rank, this->_tree_win);
-      res = result_node.rank == self_node.rank &&
-            result_node.tag == self_node.tag;
-    } else {
-      const tree_node_t new_node = {(int32_t)this->_self_rank,
-                                    self_node.tag + 1};
+  // Refreshes the leaf of `enqueuer_rank` and its ancestors up to the root.
+  // The LL of a parent is taken one round ahead, so the CAS on a node is
+  // issued together with the reads of its siblings, and the children's
+  // timestamps are read together with the grandparent: two flushes per level
+  // on the common path. A failed CAS re-reads the node's inputs and retries
+  // once, like the double refresh it replaces.
+  void _propagate(int enqueuer_rank, MPI_Aint host) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    int current_index = this->_get_enqueuer_index(enqueuer_rank);
+    int parent_index = this->_get_parent_index(current_index);
+    tree_node_t current_node;
+    tree_node_t parent_node;
+    timestamp_t min_timestamp;
+    {
+      RmaEpoch epoch;
+      epoch.aread(&min_timestamp,
+                  this->_min_timestamp_region.disp(enqueuer_rank), host,
+                  this->_win);
+      epoch.aread(&current_node, this->_tree_region.disp(current_index), host,
+                  this->_win);
+      epoch.aread(&parent_node, this->_tree_region.disp(parent_index), host,
+                  this->_win);
+    }
+    tree_node_t new_node = {min_timestamp.timestamp == MAX_TIMESTAMP
+                                ? DUMMY_RANK
+                                : (int32_t)enqueuer_rank,
+                            current_node.tag + 1};
+
+    bool retried = false;
+    while (true) {
+      tree_node_t children[Fanout];
+      int first_child = 0;
+      int children_count = 0;
+      if (parent_index >= 0) {
+        first_child = this->_get_first_child_index(parent_index);
+        children_count = this->_get_children_count(parent_index);
+      }
       tree_node_t result_node;
-      compare_and_swap_sync(&self_node, &new_node, &result_node, self_index,
-                            this->_dequeuer_rank, this->_tree_win);
-      res = result_node.rank == self_node.rank &&
-            result_node.tag == self_node.tag;
+      {
+        RmaEpoch epoch;
+        epoch.compare_and_swap(&current_node, &new_node, &result_node,
+                               this->_tree_region.disp(current_index), host,
+                               this->_win);
+        if (children_count > 0) {
+          const int self_offset = current_index - first_child;
+          epoch.batch_aread(children, self_offset,
+                            this->_tree_region.disp(first_child), host,
+                            this->_win);
+          epoch.batch_aread(children + self_offset + 1,
+                            children_count - self_offset - 1,
+                            this->_tree_region.disp(current_index + 1), host,
+                            this->_win);
+        }
+      }
+      const bool succeeded = result_node.tag == current_node.tag &&
+                             result_node.rank == current_node.rank;
+      if (!succeeded) {
+        stats_count_cas_failure();
+      }
+      if (!succeeded && !retried) {
+        retried = true;
+        current_node = result_node;
+        new_node = this->_read_new_node(current_index, enqueuer_rank,
+                                        current_node.tag, host);
+        continue;
+      }
+      if (parent_index < 0) {
+        return;
+      }
+      children[current_index - first_child] =
+          succeeded ? new_node : result_node;
+
+      const int grandparent_index = this->_get_parent_index(parent_index);
+      tree_node_t grandparent_node = {DUMMY_RANK, 0};
+      RmaEpoch epoch;
+      if (grandparent_index >= 0) {
+        epoch.aread(&grandparent_node,
+                    this->_tree_region.disp(grandparent_index), host,
+                    this->_win);
+      }
+      new_node = this->_get_min_child(children, children_count,
+                                      parent_node.tag, host, epoch);
+
+      current_index = parent_index;
+      current_node = parent_node;
+      parent_index = grandparent_index;
+      parent_node = grandparent_node;
+      retried = false;
     }
-    return res;
+  }
+
+  // Enqueuer's methods
+private:
+  void _e_propagate() {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    this->_propagate(this->_self_rank, this->_dequeuer_rank);
   }
 
   bool _e_refresh_timestamp() {
@@ -141,15 +267,17 @@ private:
     bool min_timestamp_succeeded = this->_spsc.e_read_front(&front);
 
     timestamp_t current_timestamp;
-    aread_sync(&current_timestamp, this->_self_rank, this->_dequeuer_rank,
-               this->_min_timestamp_win);
+    aread_sync(&current_timestamp,
+               this->_min_timestamp_region.disp(this->_self_rank),
+               this->_dequeuer_rank, this->_win);
     if (!min_timestamp_succeeded) {
       const timestamp_t new_timestamp = {MAX_TIMESTAMP,
                                          current_timestamp.tag + 1};
       timestamp_t result_timestamp;
       compare_and_swap_sync(&current_timestamp, &new_timestamp,
-                            &result_timestamp, this->_self_rank,
-                            this->_dequeuer_rank, this->_min_timestamp_win);
+                            &result_timestamp,
+                            this->_min_timestamp_region.disp(this->_self_rank),
+                            this->_dequeuer_rank, this->_win);
       res = result_timestamp.tag == current_timestamp.tag &&
             result_timestamp.timestamp == current_timestamp.timestamp;
     } else {
@@ -157,46 +285,15 @@ private:
                                          current_timestamp.tag + 1};
       timestamp_t result_timestamp;
       compare_and_swap_sync(&current_timestamp, &new_timestamp,
-                            &result_timestamp, this->_self_rank,
-                            this->_dequeuer_rank, this->_min_timestamp_win);
+                            &result_timestamp,
+                            this->_min_timestamp_region.disp(this->_self_rank),
+                            this->_dequeuer_rank, this->_win);
       res = result_timestamp.tag == current_timestamp.tag &&
             result_timestamp.timestamp == current_timestamp.timestamp;
     }
     return res;
   }
 
-  bool _e_refresh(int current_index) {
-#ifdef PROFILE
-    CALI_CXX_MARK_FUNCTION;
-#endif
-    tree_node_t current_node;
-    uint32_t min_timestamp = MAX_TIMESTAMP;
-    int32_t min_timestamp_rank = DUMMY_RANK;
-    aread_sync(&current_node, current_index, this->_dequeuer_rank,
-               this->_tree_win);
-    for (const int child_index : this->_get_children_indexes(current_index)) {
-      tree_node_t child_node;
-      aread_sync(&child_node, child_index, this->_dequeuer_rank,
-                 this->_tree_win);
-      if (child_node.rank == DUMMY_RANK) {
-        continue;
-      }
-      timestamp_t child_timestamp;
-      aread_sync(&child_timestamp, child_node.rank, this->_dequeuer_rank,
-                 this->_min_timestamp_win);
-      if (child_timestamp.timestamp < min_timestamp) {
-        min_timestamp = child_timestamp.timestamp;
-        min_timestamp_rank = child_node.rank;
-      }
-    }
-    const tree_node_t new_node = {min_timestamp_rank, current_node.tag + 1};
-    tree_node_t result_node;
-    compare_and_swap_sync(&current_node, &new_node, &result_node, current_index,
-                          this->_dequeuer_rank, this->_tree_win);
-    return result_node.tag == current_node.tag &&
-           result_node.rank == current_node.rank;
-  }
-
   // Dequeuer's methods
 private:
   bool _d_refresh_timestamp(int enqueuer_rank) {
@@ -210,16 +307,18 @@ private:
         this->_spsc.d_read_front(&front, enqueuer_rank);
 
     timestamp_t current_timestamp;
-    aread_sync(&current_timestamp, enqueuer_rank, this->_self_rank,
-               this->_min_timestamp_win);
+    aread_sync(&current_timestamp,
+               this->_min_timestamp_region.disp(enqueuer_rank),
+               this->_self_rank, this->_win);
 
     if (!min_timestamp_succeeded) {
       const timestamp_t new_timestamp = {MAX_TIMESTAMP,
                                          current_timestamp.tag + 1};
       timestamp_t result_timestamp;
       compare_and_swap_sync(&current_timestamp, &new_timestamp,
-                            &result_timestamp, enqueuer_rank, this->_self_rank,
-                            this->_min_timestamp_win);
+                            &result_timestamp,
+                            this->_min_timestamp_region.disp(enqueuer_rank),
+                            this->_self_rank, this->_win);
       res = result_timestamp.tag == current_timestamp.tag &&
             result_timestamp.timestamp == current_timestamp.timestamp;
     } else {
@@ -227,135 +326,62 @@ private:
                                          current_timestamp.tag + 1};
       timestamp_t result_timestamp;
       compare_and_swap_sync(&current_timestamp, &new_timestamp,
-                            &result_timestamp, enqueuer_rank, this->_self_rank,
-                            this->_min_timestamp_win);
+                            &result_timestamp,
+                            this->_min_timestamp_region.disp(enqueuer_rank),
+                            this->_self_rank, this->_win);
       res = result_timestamp.tag == current_timestamp.tag &&
             current_timestamp.timestamp == result_timestamp.timestamp;
     }
     return res;
   }
 
-  bool _d_refresh_self_node(int enqueuer_rank) {
-#ifdef PROFILE
-    CALI_CXX_MARK_FUNCTION;
-#endif
-
-    bool res;
-    int self_index = this->_get_enqueuer_index(enqueuer_rank);
-    tree_node_t self_node;
-    timestamp_t min_timestamp;
-    aread_sync(&min_timestamp, enqueuer_rank, this->_self_rank,
-               this->_min_timestamp_win);
-
-    aread_sync(&self_node, self_index, this->_self_rank, this->_tree_win);
-    if (min_timestamp.timestamp == MAX_TIMESTAMP) {
-      const tree_node_t new_node = {DUMMY_RANK, self_node.tag + 1};
-      tree_node_t result_node;
-      compare_and_swap_sync(&self_node, &new_node, &result_node, self_index,
-                            this->_self_rank, this->_tree_win);
-      res = result_node.tag == self_node.tag &&
-            result_node.rank == self_node.rank;
-    } else {
-      const tree_node_t new_node = {enqueuer_rank, self_node.tag + 1};
-      tree_node_t result_node;
-      compare_and_swap_sync(&self_node, &new_node, &result_node, self_index,
-                            this->_self_rank, this->_tree_win);
-      res = result_node.tag == self_node.tag &&
-            result_node.rank == self_node.rank;
-    }
-    return res;
-  }
-
-  bool _d_refresh(int current_index) {
-#ifdef PROFILE
-    CALI_CXX_MARK_FUNCTION;
-#endif
-
-    tree_node_t current_node;
-    uint32_t min_timestamp = MAX_TIMESTAMP;
-    int32_t min_timestamp_rank = DUMMY_RANK;
-    aread_sync(&current_node, current_index, this->_self_rank, this->_tree_win);
-    for (const int child_index : this->_get_children_indexes(current_index)) {
-      tree_node_t child_node;
-      aread_sync(&child_node, child_index, this->_self_rank, this->_tree_win);
-      if (child_node.rank == DUMMY_RANK) {
-        continue;
-      }
-      timestamp_t child_timestamp;
-      aread_sync(&child_timestamp, child_node.rank, this->_self_rank,
-                 this->_min_timestamp_win);
-      if (child_timestamp.timestamp < min_timestamp) {
-        min_timestamp = child_timestamp.timestamp;
-        min_timestamp_rank = child_node.rank;
-      }
-    }
-    const tree_node_t new_node = {min_timestamp_rank, current_node.tag + 1};
-    tree_node_t result_node;
-    compare_and_swap_sync(&current_node, &new_node, &result_node, current_index,
-                          this->_self_rank, this->_tree_win);
-    return result_node.tag == current_node.tag &&
-           result_node.rank == current_node.rank;
-  }
-
   void _d_propagate(int enqueuer_rank) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
-
-    if (!this->_d_refresh_self_node(enqueuer_rank)) {
-      this->_d_refresh_self_node(enqueuer_rank);
-    }
-    int current_index = this->_get_enqueuer_index(enqueuer_rank);
-    do {
-      current_index = this->_get_parent_index(current_index);
-      if (!this->_d_refresh(current_index)) {
-        this->_d_refresh(current_index);
-      }
-    } while (current_index != 0);
+    this->_propagate(enqueuer_rank, this->_self_rank);
   }
 
 public:
-  LTNodeQueue(MPI_Aint capacity_per_node, MPI_Aint dequeuer_rank, MPI_Comm comm)
+  LTNodeQueue(MPI_Aint capacity_per_node, MPI_Aint dequeuer_rank, MPI_Comm comm,
+              MPI_Aint batch_size = 10,
+              LastPublication publication = LastPublication::EVERY_N,
+              MPI_Aint publication_interval = 10)
       : _comm{comm}, _dequeuer_rank{dequeuer_rank},
-        _spsc{capacity_per_node, dequeuer_rank, comm},
+        _spsc{capacity_per_node, dequeuer_rank, comm, batch_size, publication,
+              publication_interval},
         _counter{dequeuer_rank, comm} {
     MPI_Comm_rank(comm, &this->_self_rank);
     MPI_Info_create(&this->_info);
     MPI_Info_set(this->_info, "same_disp_unit", "true");
     MPI_Info_set(this->_info, "accumulate_ordering", "none");
-
-    if (this->_self_rank == this->_dequeuer_rank) {
-      MPI_Win_allocate(sizeof(timestamp_t) * (_get_number_of_processes() + 1),
-                       sizeof(timestamp_t), this->_info, comm,
-                       &this->_min_timestamp_ptr, &this->_min_timestamp_win);
-      MPI_Win_allocate(this->_get_tree_size() * sizeof(tree_node_t),
-                       sizeof(tree_node_t), this->_info, comm, &this->_tree_ptr,
-                       &this->_tree_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_min_timestamp_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_tree_win);
-
+    MPI_Info_set(this->_info, "which_accumulate_ops", "replace,no_op,cswap");
+
+    const bool is_dequeuer = this->_self_rank == this->_dequeuer_rank;
+    WindowLayout layout;
+    this->_min_timestamp_region = layout.add<timestamp_t>(
+        this->_get_number_of_processes() + 1, is_dequeuer);
+    this->_tree_region =
+        layout.add<tree_node_t>(this->_get_tree_size(), is_dequeuer);
+    void *base = layout.allocate(this->_info, comm, &this->_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_win);
+
+    if (is_dequeuer) {
+      this->_min_timestamp_ptr = this->_min_timestamp_region.ptr(base);
+      this->_tree_ptr = this->_tree_region.ptr(base);
       for (int i = 0; i < this->_get_tree_size(); ++i) {
         this->_tree_ptr[i] = {DUMMY_RANK, 0};
       }
 
       const timestamp_t start_timestamp = {MAX_TIMESTAMP, 0};
       for (int i = 0; i < this->_get_number_of_processes(); ++i) {
-        awrite_async(&start_timestamp, i, this->_self_rank,
-                     this->_min_timestamp_win);
+        awrite_async(&start_timestamp, this->_min_timestamp_region.disp(i),
+                     this->_self_rank, this->_win);
       }
-    } else {
-      MPI_Win_allocate(0, sizeof(timestamp_t), this->_info, comm,
-                       &this->_min_timestamp_ptr, &this->_min_timestamp_win);
-      MPI_Win_allocate(0, sizeof(tree_node_t), this->_info, comm,
-                       &this->_tree_ptr, &this->_tree_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_min_timestamp_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_tree_win);
     }
-    MPI_Win_flush_all(this->_min_timestamp_win);
-    MPI_Win_flush_all(this->_tree_win);
+    MPI_Win_flush_all(this->_win);
     MPI_Barrier(comm);
-    MPI_Win_flush_all(this->_min_timestamp_win);
-    MPI_Win_flush_all(this->_tree_win);
+    MPI_Win_flush_all(this->_win);
   }
 
   LTNodeQueue(const LTNodeQueue &) = delete;
@@ -364,36 +390,55 @@ public:
       : _comm{other._comm}, _self_rank{other._self_rank},
         _dequeuer_rank{other._dequeuer_rank},
         _counter{std::move(other._counter)},
-        _min_timestamp_win{other._min_timestamp_win},
+        _win{other._win}, _min_timestamp_region{other._min_timestamp_region},
         _min_timestamp_ptr{other._min_timestamp_ptr},
-        _tree_win{other._tree_win}, _tree_ptr{other._tree_ptr},
-        _info{other._info}, _spsc{std::move(other._spsc)} {
+        _tree_region{other._tree_region}, _tree_ptr{other._tree_ptr},
+        _info{other._info}, _spsc{std::move(other._spsc)},
+        _stats{other._stats} {
 
-    other._min_timestamp_win = MPI_WIN_NULL;
+    other._win = MPI_WIN_NULL;
     other._min_timestamp_ptr = nullptr;
-    other._tree_win = MPI_WIN_NULL;
     other._tree_ptr = nullptr;
     other._info = MPI_INFO_NULL;
   }
 
   ~LTNodeQueue() {
-    if (_min_timestamp_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(this->_min_timestamp_win);
-      MPI_Win_free(&this->_min_timestamp_win);
-    }
-    if (_tree_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(this->_tree_win);
-      MPI_Win_free(&this->_tree_win);
+    if (_win != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(this->_win);
+      win_free(&this->_win);
     }
     if (_info != MPI_INFO_NULL) {
       MPI_Info_free(&this->_info);
     }
   }
 
+  // Collective; empties the queue in place, reusing its windows. Every
+  // enqueue must be complete and no rank may access the queue until all
+  // ranks have returned.
+  void reset() {
+    this->_counter.reset();
+    this->_spsc.reset();
+    if (this->_self_rank == this->_dequeuer_rank) {
+      for (int i = 0; i < this->_get_tree_size(); ++i) {
+        this->_tree_ptr[i] = {DUMMY_RANK, 0};
+      }
+
+      const timestamp_t start_timestamp = {MAX_TIMESTAMP, 0};
+      for (int i = 0; i < this->_get_number_of_processes(); ++i) {
+        awrite_async(&start_timestamp, this->_min_timestamp_region.disp(i),
+                     this->_self_rank, this->_win);
+      }
+    }
+    MPI_Win_flush_all(this->_win);
+    MPI_Barrier(this->_comm);
+    MPI_Win_flush_all(this->_win);
+  }
+
   bool enqueue(const T &data) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     uint32_t timestamp = this->_counter.get_and_increment();
     if (!this->_spsc.enqueue({data, timestamp})) {
@@ -422,6 +467,7 @@ public:
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     if (data.size() == 0) {
       return true;
@@ -457,15 +503,18 @@ public:
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     tree_node_t root;
-    aread_sync(&root, 0, this->_self_rank, this->_tree_win);
+    aread_sync(&root, this->_tree_region.disp(0), this->_self_rank, this->_win);
 
     if (root.rank == DUMMY_RANK) {
+      stats_count_empty_dequeue();
       return false;
     }
     data_t spsc_output;
     if (!this->_spsc.dequeue(&spsc_output, root.rank)) {
+      stats_count_empty_dequeue();
       return false;
     }
     if (!this->_d_refresh_timestamp(root.rank)) {
@@ -475,4 +524,10 @@ public:
     *output = spsc_output.data;
     return true;
   }
+
+  PublicationStats publication_stats() const {
+    return this->_spsc.publication_stats();
+  }
+
+  queue_stats_t stats() const { return this->_stats; }
 };
@@ -2,14 +2,21 @@
 
 #include "../lib/comm.hpp"
 #include "../lib/distributed-counters/faa.hpp"
-#include "../lib/spsc/bounded_spsc.hpp"
+#include "../lib/queue_arena.hpp"
+#include "../lib/spsc/record_spsc.hpp"
+#include "../lib/vector_fifo.hpp"
+#include "../lib/window_layout.hpp"
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
 #include <mpi.h>
 #include <vector>
 
-template <typename T> class LTQueue {
+template <typename T, int Fanout = 2> class LTQueue {
+  static_assert(Fanout >= 2, "LTQueue: Fanout must be at least 2");
+
 private:
   struct alignas(8) tree_node_t {
     int32_t rank;
@@ -23,25 +30,41 @@ private:
   };
   constexpr static uint32_t MAX_TIMESTAMP = ~((uint32_t)0);
 
-  struct data_t {
-    T data;
-    uint32_t timestamp;
-  };
-
   MPI_Comm _comm;
   int _self_rank;
   const MPI_Aint _dequeuer_rank;
 
   FaaCounter _counter;
 
-  MPI_Win _min_timestamp_win = MPI_WIN_NULL;
+  // The leaves' timestamps and the tree, both hosted by the dequeuer.
+  MPI_Win _win = MPI_WIN_NULL;
+  // False when the regions live in a QueueArena's window.
+  bool _owns_win = true;
+
+  WindowLayout::Region<timestamp_t> _min_timestamp_region;
   timestamp_t *_min_timestamp_ptr = nullptr;
 
-  MPI_Win _tree_win = MPI_WIN_NULL;
+  WindowLayout::Region<tree_node_t> _tree_region;
   tree_node_t *_tree_ptr = nullptr;
   MPI_Info _info = MPI_INFO_NULL;
 
-  Spsc<data_t> _spsc;
+  // An enqueue's items share one timestamp, stored once per record.
+  RecordSpsc<T, uint32_t> _spsc;
+
+  struct pending_enqueue_t {
+    std::vector<T> data;
+    MPI_Aint counter;
+    MPI_Request request = MPI_REQUEST_NULL;
+    bool issued = false;
+    bool done = false;
+    bool succeeded = false;
+  };
+  VectorFifo<std::shared_ptr<pending_enqueue_t>> _pending;
+  // Completed states that no handle refers to anymore, reused along with
+  // their buffers.
+  std::vector<std::shared_ptr<pending_enqueue_t>> _free_pending;
+
+  queue_stats_t _stats = {};
 
   int _get_number_of_processes() const {
     int number_processes;
@@ -50,85 +73,280 @@ private:
     return number_processes;
   }
 
-  int _get_tree_size() const { return 2 * this->_get_number_of_processes(); }
+  // The leaves (one per rank) follow the internal nodes, which are just
+  // enough to make every leaf the descendant of node 0.
+  static int _get_internal_nodes_count(int number_processes) {
+    return std::max(1, (number_processes - 1 + Fanout - 2) / (Fanout - 1));
+  }
+
+  int _get_internal_nodes_count() const {
+    return _get_internal_nodes_count(this->_get_number_of_processes());
+  }
+
+  int _get_tree_size() const {
+    return this->_get_internal_nodes_count() +
+           this->_get_number_of_processes();
+  }
 
   int _get_parent_index(int index) const {
     if (index == 0) {
       return -1;
     }
-    return (index - 1) / 2;
+    return (index - 1) / Fanout;
   }
 
   int _get_self_index() const {
-    return this->_get_number_of_processes() + this->_self_rank;
+    return this->_get_internal_nodes_count() + this->_self_rank;
   }
 
   int _get_enqueuer_index(int rank) const {
-    return this->_get_number_of_processes() + rank;
+    return this->_get_internal_nodes_count() + rank;
+  }
+
+  int _get_first_child_index(int index) const {
+    return index * Fanout + 1;
   }
 
-  std::vector<int> _get_children_indexes(int index) const {
-    int left_child = index * 2 + 1;
-    int right_child = index * 2 + 2;
-    std::vector<int> res;
-    if (left_child >= this->_get_tree_size()) {
-      return res;
+  int _get_children_count(int index) const {
+    const int first_child = this->_get_first_child_index(index);
+    if (first_child >= this->_get_tree_size()) {
+      return 0;
     }
-    res.push_back(left_child);
-    if (right_child >= this->_get_tree_size()) {
-      return res;
+    return std::min(Fanout, this->_get_tree_size() - first_child);
+  }
+
+  void _add_regions(WindowLayout &layout) {
+    const bool is_dequeuer = this->_self_rank == this->_dequeuer_rank;
+    this->_min_timestamp_region = layout.add<timestamp_t>(
+        this->_get_number_of_processes() + 1, is_dequeuer);
+    this->_tree_region =
+        layout.add<tree_node_t>(this->_get_tree_size(), is_dequeuer);
+  }
+
+  // Initializes the regions hosted by this rank; the window must be locked.
+  void _initialize(void *base) {
+    if (this->_self_rank == this->_dequeuer_rank) {
+      this->_min_timestamp_ptr = this->_min_timestamp_region.ptr(base);
+      this->_tree_ptr = this->_tree_region.ptr(base);
     }
-    res.push_back(right_child);
-    return res;
+    this->_reset_regions();
   }
 
-  // Enqueuer's methods
+  void _reset_regions() {
+    if (this->_self_rank != this->_dequeuer_rank) {
+      return;
+    }
+    for (int i = 0; i < this->_get_tree_size(); ++i) {
+      this->_tree_ptr[i] = {DUMMY_RANK, 0};
+    }
+
+    const timestamp_t start_timestamp = {MAX_TIMESTAMP, 0};
+    for (int i = 0; i < this->_get_number_of_processes(); ++i) {
+      awrite_async(&start_timestamp, this->_min_timestamp_region.disp(i),
+                   this->_self_rank, this->_win);
+    }
+  }
+
+  // Tree methods, shared by the enqueuer (host = dequeuer) and the dequeuer
+  // (host = self)
 private:
-  void _e_propagate() {
+  // Completes `epoch` together with the children's timestamp reads.
+  tree_node_t _get_min_child(const tree_node_t *children, int children_count,
+                             uint32_t tag, MPI_Aint host, RmaEpoch &epoch) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
-    if (!this->_e_refresh_self_node()) {
-      this->_e_refresh_self_node();
-    }
-    int current_index = this->_get_self_index();
-    do {
-      current_index = this->_get_parent_index(current_index);
-      if (!this->_e_refresh(current_index)) {
-        this->_e_refresh(current_index);
+    timestamp_t child_timestamps[Fanout];
+    for (int i = 0; i < children_count; ++i) {
+      if (children[i].rank != DUMMY_RANK) {
+        epoch.aread(&child_timestamps[i],
+                    this->_min_timestamp_region.disp(children[i].rank), host,
+                    this->_win);
       }
-    } while (current_index != 0);
+    }
+    epoch.flush();
+    uint32_t min_timestamp = MAX_TIMESTAMP;
+    int32_t min_timestamp_rank = DUMMY_RANK;
+    for (int i = 0; i < children_count; ++i) {
+      if (children[i].rank == DUMMY_RANK) {
+        continue;
+      }
+      if (child_timestamps[i].timestamp < min_timestamp) {
+        min_timestamp = child_timestamps[i].timestamp;
+        min_timestamp_rank = children[i].rank;
+      }
+    }
+    return {min_timestamp_rank, tag + 1};
   }
 
-  bool _e_refresh_self_node() {
+  tree_node_t _read_new_node(int index, int enqueuer_rank, uint32_t tag,
+                             MPI_Aint host) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
-    bool res;
-    int self_index = this->_get_self_index();
-    tree_node_t self_node;
-    timestamp_t min_timestamp;
-    aread_sync(&min_timestamp, this->_self_rank, this->_dequeuer_rank,
-               this->_min_timestamp_win);
+    if (index == this->_get_enqueuer_index(enqueuer_rank)) {
+      timestamp_t min_timestamp;
+      aread_sync(&min_timestamp,
+                 this->_min_timestamp_region.disp(enqueuer_rank), host,
+                 this->_win);
+      if (min_timestamp.timestamp == MAX_TIMESTAMP) {
+        return {DUMMY_RANK, tag + 1};
+      }
+      return {enqueuer_rank, tag + 1};
+    }
+    tree_node_t children[Fanout];
+    const int children_count = this->_get_children_count(index);
+    batch_aread_sync(
+        children, children_count,
+        this->_tree_region.disp(this->_get_first_child_index(index)), host,
+        this->_win);
+    RmaEpoch epoch;
+    return this->_get_min_child(children, children_count, tag, host, epoch);
+  }
 
-    aread_sync(&self_node, self_index, this->_dequeuer_rank, this->_tree_win);
-    if (min_timestamp.timestamp == MAX_TIMESTAMP) {
-      const tree_node_t new_node = {DUMMY_RANK, self_node.tag + 1};
-      tree_node_t result_node;
-      compare_and_swap_sync(&self_node, &new_node, &result_node, self_index,
-                            this->_dequeuer_rank, this->_tree_win);
-      res = result_node.rank == self_node.rank &&
-            result_node.tag == self_node.tag;
-    } else {
-      const tree_node_t new_node = {(int32_t)this->_self_rank,
-                                    self_node.tag + 1};
+  // Refreshes the leaf of `enqueuer_rank` and its ancestors up to the root.
+  // The LL of a parent is taken one round ahead, so the CAS on a node is
+  // issued together with the reads of its siblings, and the children's
+  // timestamps are read together with the grandparent: two flushes per level
+  // on the common path. A failed CAS re-reads the node's inputs and retries
+  // once, like the double refresh it replaces.
+  void _propagate(int enqueuer_rank, MPI_Aint host) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    int current_index = this->_get_enqueuer_index(enqueuer_rank);
+    int parent_index = this->_get_parent_index(current_index);
+    tree_node_t current_node;
+    tree_node_t parent_node;
+    timestamp_t min_timestamp;
+    {
+      RmaEpoch epoch;
+      epoch.aread(&min_timestamp,
+                  this->_min_timestamp_region.disp(enqueuer_rank), host,
+                  this->_win);
+      epoch.aread(&current_node, this->_tree_region.disp(current_index), host,
+                  this->_win);
+      epoch.aread(&parent_node, this->_tree_region.disp(parent_index), host,
+                  this->_win);
+    }
+    tree_node_t new_node = {min_timestamp.timestamp == MAX_TIMESTAMP
+                                ? DUMMY_RANK
+                                : (int32_t)enqueuer_rank,
+                            current_node.tag + 1};
+
+    bool retried = false;
+    while (true) {
+      tree_node_t children[Fanout];
+      int first_child = 0;
+      int children_count = 0;
+      if (parent_index >= 0) {
+        first_child = this->_get_first_child_index(parent_index);
+        children_count = this->_get_children_count(parent_index);
+      }
       tree_node_t result_node;
-      compare_and_swap_sync(&self_node, &new_node, &result_node, self_index,
-                            this->_dequeuer_rank, this->_tree_win);
-      res = result_node.rank == self_node.rank &&
-            result_node.tag == self_node.tag;
+      {
+        RmaEpoch epoch;
+        epoch.compare_and_swap(&current_node, &new_node, &result_node,
+                               this->_tree_region.disp(current_index), host,
+                               this->_win);
+        if (children_count > 0) {
+          const int self_offset = current_index - first_child;
+          epoch.batch_aread(children, self_offset,
+                            this->_tree_region.disp(first_child), host,
+                            this->_win);
+          epoch.batch_aread(children + self_offset + 1,
+                            children_count - self_offset - 1,
+                            this->_tree_region.disp(current_index + 1), host,
+                            this->_win);
+        }
+      }
+      const bool succeeded = result_node.tag == current_node.tag &&
+                             result_node.rank == current_node.rank;
+      if (!succeeded) {
+        stats_count_cas_failure();
+      }
+      if (!succeeded && !retried) {
+        retried = true;
+        current_node = result_node;
+        new_node = this->_read_new_node(current_index, enqueuer_rank,
+                                        current_node.tag, host);
+        continue;
+      }
+      if (parent_index < 0) {
+        return;
+      }
+      children[current_index - first_child] =
+          succeeded ? new_node : result_node;
+
+      const int grandparent_index = this->_get_parent_index(parent_index);
+      tree_node_t grandparent_node = {DUMMY_RANK, 0};
+      RmaEpoch epoch;
+      if (grandparent_index >= 0) {
+        epoch.aread(&grandparent_node,
+                    this->_tree_region.disp(grandparent_index), host,
+                    this->_win);
+      }
+      new_node = this->_get_min_child(children, children_count,
+                                      parent_node.tag, host, epoch);
+
+      current_index = parent_index;
+      current_node = parent_node;
+      parent_index = grandparent_index;
+      parent_node = grandparent_node;
+      retried = false;
     }
-    return res;
+  }
+
+  // Enqueuer's methods
+private:
+  bool _enqueue(const T &data, uint32_t timestamp) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+
+    if (!this->_spsc.enqueue(data, timestamp)) {
+      return false;
+    }
+
+    this->_e_refresh_enqueued(timestamp);
+    return true;
+  }
+
+  bool _enqueue(const T *data, size_t size, uint32_t timestamp) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+
+    if (!this->_spsc.enqueue(data, size, timestamp)) {
+      return false;
+    }
+
+    this->_e_refresh_enqueued(timestamp);
+    return true;
+  }
+
+  // Refreshes this enqueuer's leaf if the item stamped `timestamp` that it
+  // just enqueued is at the front of its spsc.
+  void _e_refresh_enqueued(uint32_t timestamp) {
+    uint32_t cur_timestamp;
+    if (!this->_spsc.e_read_front(&cur_timestamp)) {
+      cur_timestamp = MAX_TIMESTAMP;
+    }
+    if (cur_timestamp != timestamp) {
+      return;
+    }
+
+    if (!this->_e_refresh_timestamp()) {
+      this->_e_refresh_timestamp();
+    }
+    this->_e_propagate();
+  }
+
+  void _e_propagate() {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    this->_propagate(this->_self_rank, this->_dequeuer_rank);
   }
 
   bool _e_refresh_timestamp() {
@@ -137,66 +355,37 @@ private:
 #endif
     bool res;
 
-    data_t front;
-    bool min_timestamp_succeeded = this->_spsc.e_read_front(&front);
+    uint32_t front_timestamp;
+    bool min_timestamp_succeeded = this->_spsc.e_read_front(&front_timestamp);
 
     timestamp_t current_timestamp;
-    aread_sync(&current_timestamp, this->_self_rank, this->_dequeuer_rank,
-               this->_min_timestamp_win);
+    aread_sync(&current_timestamp,
+               this->_min_timestamp_region.disp(this->_self_rank),
+               this->_dequeuer_rank, this->_win);
     if (!min_timestamp_succeeded) {
       const timestamp_t new_timestamp = {MAX_TIMESTAMP,
                                          current_timestamp.tag + 1};
       timestamp_t result_timestamp;
       compare_and_swap_sync(&current_timestamp, &new_timestamp,
-                            &result_timestamp, this->_self_rank,
-                            this->_dequeuer_rank, this->_min_timestamp_win);
+                            &result_timestamp,
+                            this->_min_timestamp_region.disp(this->_self_rank),
+                            this->_dequeuer_rank, this->_win);
       res = result_timestamp.tag == current_timestamp.tag &&
             result_timestamp.timestamp == current_timestamp.timestamp;
     } else {
-      const timestamp_t new_timestamp = {front.timestamp,
+      const timestamp_t new_timestamp = {front_timestamp,
                                          current_timestamp.tag + 1};
       timestamp_t result_timestamp;
       compare_and_swap_sync(&current_timestamp, &new_timestamp,
-                            &result_timestamp, this->_self_rank,
-                            this->_dequeuer_rank, this->_min_timestamp_win);
+                            &result_timestamp,
+                            this->_min_timestamp_region.disp(this->_self_rank),
+                            this->_dequeuer_rank, this->_win);
       res = result_timestamp.tag == current_timestamp.tag &&
             result_timestamp.timestamp == current_timestamp.timestamp;
     }
     return res;
   }
 
-  bool _e_refresh(int current_index) {
-#ifdef PROFILE
-    CALI_CXX_MARK_FUNCTION;
-#endif
-    tree_node_t current_node;
-    uint32_t min_timestamp = MAX_TIMESTAMP;
-    int32_t min_timestamp_rank = DUMMY_RANK;
-    aread_sync(&current_node, current_index, this->_dequeuer_rank,
-               this->_tree_win);
-    for (const int child_index : this->_get_children_indexes(current_index)) {
-      tree_node_t child_node;
-      aread_sync(&child_node, child_index, this->_dequeuer_rank,
-                 this->_tree_win);
-      if (child_node.rank == DUMMY_RANK) {
-        continue;
-      }
-      timestamp_t child_timestamp;
-      aread_sync(&child_timestamp, child_node.rank, this->_dequeuer_rank,
-                 this->_min_timestamp_win);
-      if (child_timestamp.timestamp < min_timestamp) {
-        min_timestamp = child_timestamp.timestamp;
-        min_timestamp_rank = child_node.rank;
-      }
-    }
-    const tree_node_t new_node = {min_timestamp_rank, current_node.tag + 1};
-    tree_node_t result_node;
-    compare_and_swap_sync(&current_node, &new_node, &result_node, current_index,
-                          this->_dequeuer_rank, this->_tree_win);
-    return result_node.tag == current_node.tag &&
-           result_node.rank == current_node.rank;
-  }
-
   // Dequeuer's methods
 private:
   bool _d_refresh_timestamp(int enqueuer_rank) {
@@ -205,157 +394,160 @@ private:
 #endif
     bool res;
 
-    data_t front;
+    uint32_t front_timestamp;
     bool min_timestamp_succeeded =
-        this->_spsc.d_read_front(&front, enqueuer_rank);
+        this->_spsc.d_read_front(&front_timestamp, enqueuer_rank);
 
     timestamp_t current_timestamp;
-    aread_sync(&current_timestamp, enqueuer_rank, this->_self_rank,
-               this->_min_timestamp_win);
+    aread_sync(&current_timestamp,
+               this->_min_timestamp_region.disp(enqueuer_rank),
+               this->_self_rank, this->_win);
 
     if (!min_timestamp_succeeded) {
       const timestamp_t new_timestamp = {MAX_TIMESTAMP,
                                          current_timestamp.tag + 1};
       timestamp_t result_timestamp;
       compare_and_swap_sync(&current_timestamp, &new_timestamp,
-                            &result_timestamp, enqueuer_rank, this->_self_rank,
-                            this->_min_timestamp_win);
+                            &result_timestamp,
+                            this->_min_timestamp_region.disp(enqueuer_rank),
+                            this->_self_rank, this->_win);
       res = result_timestamp.tag == current_timestamp.tag &&
             result_timestamp.timestamp == current_timestamp.timestamp;
     } else {
-      const timestamp_t new_timestamp = {front.timestamp,
+      const timestamp_t new_timestamp = {front_timestamp,
                                          current_timestamp.tag + 1};
       timestamp_t result_timestamp;
       compare_and_swap_sync(&current_timestamp, &new_timestamp,
-                            &result_timestamp, enqueuer_rank, this->_self_rank,
-                            this->_min_timestamp_win);
+                            &result_timestamp,
+                            this->_min_timestamp_region.disp(enqueuer_rank),
+                            this->_self_rank, this->_win);
       res = result_timestamp.tag == current_timestamp.tag &&
             current_timestamp.timestamp == result_timestamp.timestamp;
     }
     return res;
   }
 
-  bool _d_refresh_self_node(int enqueuer_rank) {
+  void _d_propagate(int enqueuer_rank) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
-
-    bool res;
-    int self_index = this->_get_enqueuer_index(enqueuer_rank);
-    tree_node_t self_node;
-    timestamp_t min_timestamp;
-    aread_sync(&min_timestamp, enqueuer_rank, this->_self_rank,
-               this->_min_timestamp_win);
-
-    aread_sync(&self_node, self_index, this->_self_rank, this->_tree_win);
-    if (min_timestamp.timestamp == MAX_TIMESTAMP) {
-      const tree_node_t new_node = {DUMMY_RANK, self_node.tag + 1};
-      tree_node_t result_node;
-      compare_and_swap_sync(&self_node, &new_node, &result_node, self_index,
-                            this->_self_rank, this->_tree_win);
-      res = result_node.tag == self_node.tag &&
-            result_node.rank == self_node.rank;
-    } else {
-      const tree_node_t new_node = {enqueuer_rank, self_node.tag + 1};
-      tree_node_t result_node;
-      compare_and_swap_sync(&self_node, &new_node, &result_node, self_index,
-                            this->_self_rank, this->_tree_win);
-      res = result_node.tag == self_node.tag &&
-            result_node.rank == self_node.rank;
-    }
-    return res;
+    this->_propagate(enqueuer_rank, this->_self_rank);
   }
 
-  bool _d_refresh(int current_index) {
-#ifdef PROFILE
-    CALI_CXX_MARK_FUNCTION;
-#endif
-
-    tree_node_t current_node;
-    uint32_t min_timestamp = MAX_TIMESTAMP;
-    int32_t min_timestamp_rank = DUMMY_RANK;
-    aread_sync(&current_node, current_index, this->_self_rank, this->_tree_win);
-    for (const int child_index : this->_get_children_indexes(current_index)) {
-      tree_node_t child_node;
-      aread_sync(&child_node, child_index, this->_self_rank, this->_tree_win);
-      if (child_node.rank == DUMMY_RANK) {
-        continue;
+public:
+  // Completion handle of enqueue_deferred. It must not outlive its queue, and
+  // the queue must not be moved while enqueues are pending.
+  class EnqueueHandle {
+    LTQueue *_queue;
+    std::shared_ptr<pending_enqueue_t> _state;
+
+  public:
+    EnqueueHandle(LTQueue *queue, std::shared_ptr<pending_enqueue_t> state)
+        : _queue{queue}, _state{std::move(state)} {}
+
+    bool test() {
+      if (!this->_state->done) {
+        this->_queue->progress();
       }
-      timestamp_t child_timestamp;
-      aread_sync(&child_timestamp, child_node.rank, this->_self_rank,
-                 this->_min_timestamp_win);
-      if (child_timestamp.timestamp < min_timestamp) {
-        min_timestamp = child_timestamp.timestamp;
-        min_timestamp_rank = child_node.rank;
+      return this->_state->done;
+    }
+
+    // Returns whether the enqueue succeeded.
+    bool wait() {
+      while (!this->_state->done) {
+        this->_queue->progress();
       }
+      return this->_state->succeeded;
     }
-    const tree_node_t new_node = {min_timestamp_rank, current_node.tag + 1};
-    tree_node_t result_node;
-    compare_and_swap_sync(&current_node, &new_node, &result_node, current_index,
-                          this->_self_rank, this->_tree_win);
-    return result_node.tag == current_node.tag &&
-           result_node.rank == current_node.rank;
-  }
+  };
 
-  void _d_propagate(int enqueuer_rank) {
-#ifdef PROFILE
-    CALI_CXX_MARK_FUNCTION;
-#endif
+private:
+  std::shared_ptr<pending_enqueue_t> _acquire_pending() {
+    if (this->_free_pending.empty()) {
+      return std::make_shared<pending_enqueue_t>();
+    }
+    std::shared_ptr<pending_enqueue_t> state =
+        std::move(this->_free_pending.back());
+    this->_free_pending.pop_back();
+    state->request = MPI_REQUEST_NULL;
+    state->issued = false;
+    state->done = false;
+    state->succeeded = false;
+    return state;
+  }
 
-    if (!this->_d_refresh_self_node(enqueuer_rank)) {
-      this->_d_refresh_self_node(enqueuer_rank);
+  EnqueueHandle _enqueueDeferred(const T *data, size_t size) {
+    std::shared_ptr<pending_enqueue_t> state = this->_acquire_pending();
+    state->data.assign(data, data + size);
+    if (state->data.empty()) {
+      state->done = true;
+      state->succeeded = true;
+      return EnqueueHandle(this, state);
     }
-    int current_index = this->_get_enqueuer_index(enqueuer_rank);
-    do {
-      current_index = this->_get_parent_index(current_index);
-      if (!this->_d_refresh(current_index)) {
-        this->_d_refresh(current_index);
-      }
-    } while (current_index != 0);
+    // One counter request in flight per queue, so timestamps stay in
+    // enqueue order even without accumulate ordering.
+    if (this->_pending.empty()) {
+      this->_counter.get_and_increment_async(&state->counter, &state->request);
+      state->issued = true;
+    }
+    this->_pending.push_back(state);
+    return EnqueueHandle(this, state);
   }
 
 public:
-  LTQueue(MPI_Aint capacity_per_node, MPI_Aint dequeuer_rank, MPI_Comm comm)
+  LTQueue(MPI_Aint capacity_per_node, MPI_Aint dequeuer_rank, MPI_Comm comm,
+          MPI_Aint batch_size = 10,
+          LastPublication publication = LastPublication::EVERY_N,
+          MPI_Aint publication_interval = 10,
+          MPI_Aint lease_size = 1)
       : _comm{comm}, _dequeuer_rank{dequeuer_rank},
-        _spsc{capacity_per_node, dequeuer_rank, comm},
-        _counter{dequeuer_rank, comm} {
+        _spsc{capacity_per_node, dequeuer_rank, comm, batch_size, publication,
+              publication_interval},
+        _counter{dequeuer_rank, comm, lease_size} {
     MPI_Comm_rank(comm, &this->_self_rank);
     MPI_Info_create(&this->_info);
     MPI_Info_set(this->_info, "same_disp_unit", "true");
     MPI_Info_set(this->_info, "accumulate_ordering", "none");
+    MPI_Info_set(this->_info, "which_accumulate_ops", "replace,no_op,cswap");
+
+    WindowLayout layout;
+    this->_add_regions(layout);
+    void *base = layout.allocate(this->_info, comm, &this->_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_win);
+    this->_initialize(base);
+    MPI_Win_flush_all(this->_win);
+    MPI_Barrier(comm);
+    MPI_Win_flush_all(this->_win);
+  }
 
-    if (this->_self_rank == this->_dequeuer_rank) {
-      MPI_Win_allocate(sizeof(timestamp_t) * (_get_number_of_processes() + 1),
-                       sizeof(timestamp_t), this->_info, comm,
-                       &this->_min_timestamp_ptr, &this->_min_timestamp_win);
-      MPI_Win_allocate(this->_get_tree_size() * sizeof(tree_node_t),
-                       sizeof(tree_node_t), this->_info, comm, &this->_tree_ptr,
-                       &this->_tree_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_min_timestamp_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_tree_win);
-
-      for (int i = 0; i < this->_get_tree_size(); ++i) {
-        this->_tree_ptr[i] = {DUMMY_RANK, 0};
-      }
+  // Carves the queue, its counter and its SPSCs from `arena`; see QueueArena
+  // for the protocol.
+  LTQueue(MPI_Aint capacity_per_node, MPI_Aint dequeuer_rank,
+          QueueArena &arena, MPI_Aint batch_size = 10,
+          LastPublication publication = LastPublication::EVERY_N,
+          MPI_Aint publication_interval = 10,
+          MPI_Aint lease_size = 1)
+      : _comm{arena.comm()}, _dequeuer_rank{dequeuer_rank},
+        _counter{dequeuer_rank, arena, lease_size}, _win{arena.win()},
+        _owns_win{false},
+        _spsc{capacity_per_node, dequeuer_rank, arena, batch_size,
+              publication, publication_interval} {
+    MPI_Comm_rank(this->_comm, &this->_self_rank);
+
+    WindowLayout layout = arena.layout();
+    this->_add_regions(layout);
+    this->_initialize(arena.allocate(layout));
+  }
 
-      const timestamp_t start_timestamp = {MAX_TIMESTAMP, 0};
-      for (int i = 0; i < this->_get_number_of_processes(); ++i) {
-        awrite_async(&start_timestamp, i, this->_self_rank,
-                     this->_min_timestamp_win);
-      }
-    } else {
-      MPI_Win_allocate(0, sizeof(timestamp_t), this->_info, comm,
-                       &this->_min_timestamp_ptr, &this->_min_timestamp_win);
-      MPI_Win_allocate(0, sizeof(tree_node_t), this->_info, comm,
-                       &this->_tree_ptr, &this->_tree_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_min_timestamp_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_tree_win);
-    }
-    MPI_Win_flush_all(this->_min_timestamp_win);
-    MPI_Win_flush_all(this->_tree_win);
-    MPI_Barrier(comm);
-    MPI_Win_flush_all(this->_min_timestamp_win);
-    MPI_Win_flush_all(this->_tree_win);
+  // Arena space one queue takes on a communicator of `comm_size` ranks.
+  static MPI_Aint arena_size(MPI_Aint capacity_per_node, int comm_size) {
+    WindowLayout layout;
+    layout.add<timestamp_t>(comm_size + 1, true);
+    layout.add<tree_node_t>(_get_internal_nodes_count(comm_size) + comm_size,
+                            true);
+    return FaaCounter::arena_size() +
+           RecordSpsc<T, uint32_t>::arena_size(capacity_per_node, comm_size) +
+           QueueArena::footprint(layout);
   }
 
   LTQueue(const LTQueue &) = delete;
@@ -365,115 +557,212 @@ public:
       : _comm{other._comm}, _self_rank{other._self_rank},
         _dequeuer_rank{other._dequeuer_rank},
         _counter{std::move(other._counter)},
-        _min_timestamp_win{other._min_timestamp_win},
+        _win{other._win}, _owns_win{other._owns_win},
+        _min_timestamp_region{other._min_timestamp_region},
         _min_timestamp_ptr{other._min_timestamp_ptr},
-        _tree_win{other._tree_win}, _tree_ptr{other._tree_ptr},
-        _info{other._info}, _spsc{std::move(other._spsc)} {
+        _tree_region{other._tree_region}, _tree_ptr{other._tree_ptr},
+        _info{other._info}, _spsc{std::move(other._spsc)},
+        _pending{std::move(other._pending)},
+        _free_pending{std::move(other._free_pending)},
+        _stats{other._stats} {
 
-    other._min_timestamp_win = MPI_WIN_NULL;
+    other._win = MPI_WIN_NULL;
     other._min_timestamp_ptr = nullptr;
-    other._tree_win = MPI_WIN_NULL;
     other._tree_ptr = nullptr;
     other._info = MPI_INFO_NULL;
   }
 
   ~LTQueue() {
-    if (_min_timestamp_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(this->_min_timestamp_win);
-      MPI_Win_free(&this->_min_timestamp_win);
-    }
-    if (_tree_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(this->_tree_win);
-      MPI_Win_free(&this->_tree_win);
+    if (_win != MPI_WIN_NULL) {
+      this->wait_all();
+      if (_owns_win) {
+        MPI_Win_unlock_all(this->_win);
+        win_free(&this->_win);
+      }
     }
     if (_info != MPI_INFO_NULL) {
       MPI_Info_free(&this->_info);
     }
   }
 
+  // Collective; empties the queue in place, reusing its windows. Every
+  // enqueue must be complete and no rank may access the queue until all
+  // ranks have returned.
+  void reset() {
+    this->reset_local();
+    MPI_Barrier(this->_comm);
+    MPI_Win_flush_all(this->_win);
+  }
+
+  // The part of reset() before its barrier, so that several queues can be
+  // reset behind a single barrier.
+  void reset_local() {
+    this->_counter.reset();
+    this->_spsc.reset();
+    this->_reset_regions();
+    MPI_Win_flush_all(this->_win);
+  }
+
+  // Completes this rank's deferred enqueues first, so that a producer's items
+  // stay in FIFO order across both kinds of enqueue.
   bool enqueue(const T &data) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
-    uint32_t timestamp = this->_counter.get_and_increment();
-    if (!this->_spsc.enqueue({data, timestamp})) {
-      return false;
-    }
+    this->wait_all();
+    return this->_enqueue(data, this->_counter.get_and_increment());
+  }
 
-    data_t front;
-    uint32_t cur_timestamp;
-    if (!this->_spsc.e_read_front(&front)) {
-      cur_timestamp = MAX_TIMESTAMP;
-    } else {
-      cur_timestamp = front.timestamp;
-    }
-    if (cur_timestamp != timestamp) {
+  bool enqueue(const std::vector<T> &data) {
+    return this->enqueue(data.data(), data.size());
+  }
+
+  // Enqueues `size` items from `data` as one batch, without allocating.
+  bool enqueue(const T *data, size_t size) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    if (size == 0) {
       return true;
     }
+    this->wait_all();
+    return this->_enqueue(data, size, this->_counter.get_and_increment());
+  }
 
-    if (!this->_e_refresh_timestamp()) {
-      this->_e_refresh_timestamp();
-    }
-    this->_e_propagate();
-    return true;
+  // Room for items to construct in place, see reserve().
+  typedef typename RecordSpsc<T, uint32_t>::reservation_t Reservation;
+
+  // Reserves room for `size` > 0 items and returns where to construct them,
+  // in this rank's ring when possible so they are written only once. `data`
+  // is nullptr if the queue is full. No other enqueue may happen until the
+  // reservation is committed.
+  Reservation reserve(size_t size) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    this->wait_all();
+    return this->_spsc.reserve(size);
   }
 
-  bool enqueue(const std::vector<T> &data) {
+  // Enqueues the reserved items as one batch. Their timestamp is taken here,
+  // so they are ordered by commit rather than by reserve.
+  bool commit(const Reservation &reservation) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
-    if (data.size() == 0) {
-      return true;
-    }
-    uint32_t timestamp = this->_counter.get_and_increment();
-    std::vector<data_t> timestamped_data;
-    for (const T &datum : data) {
-      timestamped_data.push_back(data_t{datum, timestamp});
-    }
-    if (!this->_spsc.enqueue(timestamped_data)) {
+    if (reservation.data == nullptr) {
       return false;
     }
+    const uint32_t timestamp = this->_counter.get_and_increment();
+    this->_spsc.commit(reservation, timestamp);
+    this->_e_refresh_enqueued(timestamp);
+    return true;
+  }
 
-    data_t front;
-    uint32_t cur_timestamp;
-    if (!this->_spsc.e_read_front(&front)) {
-      cur_timestamp = MAX_TIMESTAMP;
-    } else {
-      cur_timestamp = front.timestamp;
-    }
-    if (cur_timestamp != timestamp) {
-      return true;
+  // Requests the enqueue's timestamp with a request-based FAA and defers the
+  // rest of it: the ring write, the last index publication and the tree refresh
+  // run with blocking RMA inside progress() or the handle's test()/wait(),
+  // which complete enqueues to the same queue in order.
+  EnqueueHandle enqueue_deferred(const T &data) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    return this->_enqueueDeferred(&data, 1);
+  }
+
+  EnqueueHandle enqueue_deferred(const std::vector<T> &data) {
+    return this->enqueue_deferred(data.data(), data.size());
+  }
+
+  // The items are copied into a pending state, recycled once the enqueue has
+  // completed and its handle is gone.
+  EnqueueHandle enqueue_deferred(const T *data, size_t size) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    return this->_enqueueDeferred(data, size);
+  }
+
+  // Completes pending enqueues in order, each with blocking RMA, until one's
+  // timestamp is not yet available.
+  void progress() {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    while (!this->_pending.empty()) {
+      pending_enqueue_t &head = *this->_pending.front();
+      if (!head.issued) {
+        this->_counter.get_and_increment_async(&head.counter, &head.request);
+        head.issued = true;
+      }
+      int completed;
+      MPI_Test(&head.request, &completed, MPI_STATUS_IGNORE);
+      if (!completed) {
+        return;
+      }
+      if (head.data.size() == 1) {
+        head.succeeded = this->_enqueue(head.data[0], head.counter);
+      } else {
+        head.succeeded = this->_enqueue(head.data.data(), head.data.size(),
+                                        head.counter);
+      }
+      head.done = true;
+      std::shared_ptr<pending_enqueue_t> state =
+          std::move(this->_pending.front());
+      this->_pending.pop_front();
+      if (state.use_count() == 1) {
+        this->_free_pending.push_back(std::move(state));
+      }
     }
+  }
 
-    if (!this->_e_refresh_timestamp()) {
-      this->_e_refresh_timestamp();
+  void wait_all() {
+    while (!this->_pending.empty()) {
+      this->progress();
     }
-    this->_e_propagate();
-    return true;
   }
 
   bool dequeue(T *output) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     tree_node_t root;
-    aread_sync(&root, 0, this->_self_rank, this->_tree_win);
+    aread_sync(&root, this->_tree_region.disp(0), this->_self_rank, this->_win);
 
     if (root.rank == DUMMY_RANK) {
+      stats_count_empty_dequeue();
       return false;
     }
-    data_t spsc_output;
-    if (!this->_spsc.dequeue(&spsc_output, root.rank)) {
+    if (!this->_spsc.dequeue(output, root.rank)) {
+      stats_count_empty_dequeue();
       return false;
     }
     if (!this->_d_refresh_timestamp(root.rank)) {
       this->_d_refresh_timestamp(root.rank);
     }
     this->_d_propagate(root.rank);
-    *output = spsc_output.data;
     return true;
   }
+
+  PublicationStats publication_stats() const {
+    return this->_spsc.publication_stats();
+  }
+
+  queue_stats_t stats() const { return this->_stats; }
 };
@@ -43,6 +43,8 @@ private:
 
   UnboundedSpsc<data_t> _spsc;
 
+  queue_stats_t _stats = {};
+
   int _get_number_of_processes() const {
     int number_processes;
     MPI_Comm_size(this->_comm, &number_processes);
@@ -365,7 +367,8 @@ public:
         _min_timestamp_win{other._min_timestamp_win},
         _min_timestamp_ptr{other._min_timestamp_ptr},
         _tree_win{other._tree_win}, _tree_ptr{other._tree_ptr},
-        _info{other._info}, _spsc{std::move(other._spsc)} {
+        _info{other._info}, _spsc{std::move(other._spsc)},
+        _stats{other._stats} {
 
     other._min_timestamp_win = MPI_WIN_NULL;
     other._min_timestamp_ptr = nullptr;
@@ -392,6 +395,7 @@ public:
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     uint32_t timestamp = this->_counter.get_and_increment();
     if (!this->_spsc.enqueue({data, timestamp})) {
@@ -420,6 +424,7 @@ public:
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     if (data.size() == 0) {
       return true;
@@ -444,15 +449,18 @@ public:
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     tree_node_t root;
     aread_sync(&root, 0, this->_self_rank, this->_tree_win);
 
     if (root.rank == DUMMY_RANK) {
+      stats_count_empty_dequeue();
       return false;
     }
     data_t spsc_output;
     if (!this->_spsc.dequeue(&spsc_output, root.rank)) {
+      stats_count_empty_dequeue();
       return false;
     }
     if (!this->_d_refresh_timestamp(root.rank)) {
@@ -462,4 +470,6 @@ public:
     *output = spsc_output.data;
     return true;
   }
+
+  queue_stats_t stats() const { return this->_stats; }
 };
@@ -1,4 +1,10 @@
 #define PROFILE 1
+// Serve node-local RMA targets with CPU atomics, see lib/node_local.hpp
+// #define NODE_LOCAL_FAST_PATH 1
+// Serve each rank's RMA targets on itself with CPU atomics, same file
+// #define SELF_TARGET_FAST_PATH 1
+// Count each queue's remote operations and report them, see lib/stats.hpp
+// #define QUEUE_STATS 1
 
 #ifdef PROFILE
 #include <caliper/cali.h>
@@ -76,13 +82,21 @@ int main(int argc, char **argv) {
     report_RMO_latency_single();
     report_RMO_latency_all_to_one();
     report_RMO_latency_all_to_all();
+    report_RMO_latency_accumulate_datatypes();
   }
 
   if (run_micro) {
     slotqueue_single_one_queue_microbenchmark(100000, 5);
+    slotqueue_single_one_queue_microbenchmark<ClockCounter>(100000, 5);
+    slotqueue_reordering_microbenchmark<FaaCounter>(100000);
+    slotqueue_reordering_microbenchmark<ClockCounter>(100000);
     unbounded_slotqueue_single_one_queue_microbenchmark(100000, 5);
     slotqueue_node_single_one_queue_microbenchmark(100000, 5);
+    hierarchical_slotqueue_single_one_queue_microbenchmark(100000, 5);
     ltqueue_single_one_queue_microbenchmark(100000, 5);
+    ltqueue_single_one_queue_microbenchmark<4>(100000, 5);
+    ltqueue_single_one_queue_microbenchmark<8>(100000, 5);
+    ltqueue_single_one_queue_microbenchmark<16>(100000, 5);
     unbounded_ltqueue_single_one_queue_microbenchmark(100000, 5);
     ltqueue_node_single_one_queue_microbenchmark(100000, 5);
     naive_ltqueue_single_one_queue_microbenchmark(100000, 5);
@@ -0,0 +1,410 @@
+#pragma once
+
+#include "../lib/argmin.hpp"
+#include "../lib/comm.hpp"
+#include "../lib/distributed-counters/faa.hpp"
+#include "../lib/spsc/bounded_spsc.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mpi.h>
+#include <vector>
+
+// Slot-queue with a two-level slot array: the per-rank slots are grouped
+// (by default one group per shared-memory node) and every group keeps a summary
+// slot holding the minimum timestamp of its members. The dequeuer scans the
+// group summaries, then only the members of the chosen group.
+template <typename T> class HierarchicalSlotQueue {
+private:
+  typedef uint64_t timestamp_t;
+  constexpr static timestamp_t MAX_TIMESTAMP = ~((uint64_t)0);
+  constexpr static MPI_Aint DUMMY_RANK = ~((MPI_Aint)0);
+
+  struct data_t {
+    T data;
+    uint64_t timestamp;
+  };
+
+  MPI_Comm _comm;
+  MPI_Aint _size;
+  int _self_rank;
+  const MPI_Aint _dequeuer_rank;
+
+  FaaCounter _counter;
+
+  // Slots [0, _size) are the per-rank slots, ordered so that the members of a
+  // group are contiguous. Slots [_size, _size + _group_count) are the group
+  // summaries.
+  MPI_Win _min_timestamp_win = MPI_WIN_NULL;
+  timestamp_t *_min_timestamp_ptr = nullptr;
+  timestamp_t *_min_timestamp_buf = nullptr;
+
+  MPI_Aint _group_count;
+  std::vector<MPI_Aint> _group_of;
+  std::vector<MPI_Aint> _slot_of;
+  std::vector<MPI_Aint> _slot_rank;
+  std::vector<MPI_Aint> _group_offset;
+  // Scratch space for the member slots of one group, see _refreshGroup.
+  std::vector<timestamp_t> _group_buf;
+
+  MPI_Info _info = MPI_INFO_NULL;
+
+  Spsc<data_t> _spsc;
+
+  queue_stats_t _stats = {};
+
+private:
+  void _buildGroups(MPI_Aint group_size) {
+    std::vector<int> leaders(this->_size);
+    if (group_size <= 0) {
+      MPI_Comm sm_comm;
+      MPI_Comm_split_type(this->_comm, MPI_COMM_TYPE_SHARED, this->_self_rank,
+                          MPI_INFO_NULL, &sm_comm);
+      int leader = this->_self_rank;
+      MPI_Allreduce(MPI_IN_PLACE, &leader, 1, MPI_INT, MPI_MIN, sm_comm);
+      MPI_Comm_free(&sm_comm);
+      MPI_Allgather(&leader, 1, MPI_INT, leaders.data(), 1, MPI_INT,
+                    this->_comm);
+    } else {
+      for (int i = 0; i < this->_size; ++i) {
+        leaders[i] = i / group_size;
+      }
+    }
+
+    std::map<int, MPI_Aint> group_ids;
+    for (int i = 0; i < this->_size; ++i) {
+      group_ids.emplace(leaders[i], group_ids.size());
+    }
+    this->_group_count = group_ids.size();
+    this->_group_of = std::vector<MPI_Aint>(this->_size);
+    this->_group_offset = std::vector<MPI_Aint>(this->_group_count + 1, 0);
+    for (int i = 0; i < this->_size; ++i) {
+      this->_group_of[i] = group_ids[leaders[i]];
+      ++this->_group_offset[this->_group_of[i] + 1];
+    }
+    MPI_Aint max_group_size = 0;
+    for (int g = 0; g < this->_group_count; ++g) {
+      max_group_size = std::max(max_group_size, this->_group_offset[g + 1]);
+      this->_group_offset[g + 1] += this->_group_offset[g];
+    }
+    this->_group_buf = std::vector<timestamp_t>(max_group_size);
+    std::vector<MPI_Aint> next_slot(this->_group_offset.begin(),
+                                    this->_group_offset.end() - 1);
+    this->_slot_of = std::vector<MPI_Aint>(this->_size);
+    this->_slot_rank = std::vector<MPI_Aint>(this->_size);
+    for (int i = 0; i < this->_size; ++i) {
+      MPI_Aint slot = next_slot[this->_group_of[i]]++;
+      this->_slot_of[i] = slot;
+      this->_slot_rank[slot] = i;
+    }
+  }
+
+  MPI_Aint _group_slot(MPI_Aint group) const { return this->_size + group; }
+
+  MPI_Aint _group_size(MPI_Aint group) const {
+    return this->_group_offset[group + 1] - this->_group_offset[group];
+  }
+
+  bool _refreshEnqueue(timestamp_t ts) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    const MPI_Aint slot = this->_slot_of[this->_self_rank];
+    data_t front;
+    timestamp_t new_timestamp;
+    timestamp_t old_timestamp;
+    fetch_and_add_sync(&old_timestamp, 0, slot, this->_dequeuer_rank,
+                       this->_min_timestamp_win);
+    if (!this->_spsc.e_read_front(&front)) {
+      new_timestamp = MAX_TIMESTAMP;
+    } else {
+      new_timestamp = front.timestamp;
+    }
+    if (new_timestamp != ts) {
+      return true;
+    }
+    timestamp_t result;
+    compare_and_swap_sync(&old_timestamp, &new_timestamp, &result, slot,
+                          this->_dequeuer_rank, this->_min_timestamp_win);
+    return result == old_timestamp;
+  }
+
+  bool _refreshGroup(MPI_Aint group, MPI_Aint target_rank) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    timestamp_t old_timestamp;
+    fetch_and_add_sync(&old_timestamp, 0, this->_group_slot(group), target_rank,
+                       this->_min_timestamp_win);
+    const MPI_Aint group_size = this->_group_size(group);
+    timestamp_t *members = this->_group_buf.data();
+    batch_aread_sync(members, group_size, this->_group_offset[group],
+                     target_rank, this->_min_timestamp_win);
+    timestamp_t new_timestamp = members[argmin(members, group_size)];
+    timestamp_t result;
+    compare_and_swap_sync(&old_timestamp, &new_timestamp, &result,
+                          this->_group_slot(group), target_rank,
+                          this->_min_timestamp_win);
+    return result == old_timestamp;
+  }
+
+  // Same double scan as SlotQueue::_readMinimumRank over `count` slots
+  // starting at `offset`, returns the index relative to `offset`.
+  MPI_Aint _readMinimumSlot(MPI_Aint offset, MPI_Aint count) {
+    batch_aread_sync(this->_min_timestamp_buf, count, offset, this->_self_rank,
+                     this->_min_timestamp_win);
+    MPI_Aint index = argmin(this->_min_timestamp_buf, count);
+    timestamp_t min_timestamp = this->_min_timestamp_buf[index];
+    if (min_timestamp == MAX_TIMESTAMP) {
+      return DUMMY_RANK;
+    }
+    if (index > 0) {
+      batch_aread_sync(this->_min_timestamp_buf, index, offset,
+                       this->_self_rank, this->_min_timestamp_win);
+      MPI_Aint prefix_index = argmin(this->_min_timestamp_buf, index);
+      if (this->_min_timestamp_buf[prefix_index] < min_timestamp) {
+        index = prefix_index;
+      }
+    }
+    return index;
+  }
+
+  MPI_Aint _readMinimumRank() {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+
+    // A group summary may still hold a timestamp its members no longer have,
+    // in which case the summary is refreshed and the scan is retried until
+    // the summaries and the member slots agree. Only the dequeuer empties
+    // member slots, so a summary only stays stale while an enqueuer's refresh
+    // that read them earlier is still landing.
+    while (true) {
+      MPI_Aint group = this->_readMinimumSlot(this->_size, this->_group_count);
+      if (group == DUMMY_RANK) {
+        return DUMMY_RANK;
+      }
+      MPI_Aint member = this->_readMinimumSlot(this->_group_offset[group],
+                                               this->_group_size(group));
+      if (member != DUMMY_RANK) {
+        return this->_slot_rank[this->_group_offset[group] + member];
+      }
+      if (!this->_refreshGroup(group, this->_self_rank)) {
+        this->_refreshGroup(group, this->_self_rank);
+      }
+    }
+  }
+
+  bool _refreshDequeue(MPI_Aint rank) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+
+    const MPI_Aint slot = this->_slot_of[rank];
+    timestamp_t old_timestamp;
+    fetch_and_add_sync(&old_timestamp, 0, slot, this->_self_rank,
+                       this->_min_timestamp_win);
+    data_t front;
+    timestamp_t new_timestamp;
+    if (!this->_spsc.d_read_front(&front, rank)) {
+      new_timestamp = MAX_TIMESTAMP;
+    } else {
+      new_timestamp = front.timestamp;
+    }
+    timestamp_t result;
+    compare_and_swap_sync(&old_timestamp, &new_timestamp, &result, slot,
+                          this->_self_rank, this->_min_timestamp_win);
+    return result == old_timestamp;
+  }
+
+public:
+  // group_size <= 0 groups ranks by shared-memory node, otherwise ranks are
+  // grouped in contiguous blocks of group_size.
+  HierarchicalSlotQueue(MPI_Aint capacity_per_node, MPI_Aint dequeuer_rank,
+                        MPI_Comm comm, MPI_Aint group_size = 0,
+                        MPI_Aint batch_size = 10,
+                        LastPublication publication = LastPublication::EVERY_N,
+                        MPI_Aint publication_interval = 10)
+      : _comm{comm}, _dequeuer_rank{dequeuer_rank},
+        _counter{dequeuer_rank, comm},
+        _spsc{capacity_per_node, dequeuer_rank, comm, batch_size, publication,
+              publication_interval} {
+    int size;
+    MPI_Comm_rank(comm, &this->_self_rank);
+    MPI_Comm_size(comm, &size);
+    this->_size = size;
+    this->_buildGroups(group_size);
+
+    MPI_Info_create(&this->_info);
+    MPI_Info_set(this->_info, "same_disp_unit", "true");
+    MPI_Info_set(this->_info, "accumulate_ordering", "none");
+    MPI_Info_set(this->_info, "which_accumulate_ops", "no_op,sum,cswap");
+
+    const MPI_Aint slots = this->_size + this->_group_count;
+    if (this->_self_rank == this->_dequeuer_rank) {
+      win_allocate(slots * sizeof(timestamp_t), sizeof(timestamp_t),
+                   this->_info, comm, &this->_min_timestamp_ptr,
+                   &this->_min_timestamp_win);
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_min_timestamp_win);
+
+      for (int i = 0; i < slots; ++i) {
+        this->_min_timestamp_ptr[i] = MAX_TIMESTAMP;
+      }
+      this->_min_timestamp_buf = new timestamp_t[this->_size];
+    } else {
+      win_allocate(0, sizeof(timestamp_t), this->_info, comm,
+                   &this->_min_timestamp_ptr, &this->_min_timestamp_win);
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, _min_timestamp_win);
+    }
+    MPI_Win_flush_all(this->_min_timestamp_win);
+    MPI_Barrier(comm);
+    MPI_Win_flush_all(this->_min_timestamp_win);
+  }
+
+  HierarchicalSlotQueue(const HierarchicalSlotQueue &) = delete;
+  HierarchicalSlotQueue &operator=(const HierarchicalSlotQueue &) = delete;
+
+  HierarchicalSlotQueue(HierarchicalSlotQueue &&other) noexcept
+      : _comm(other._comm), _size(other._size), _self_rank(other._self_rank),
+        _dequeuer_rank(other._dequeuer_rank),
+        _counter(std::move(other._counter)),
+        _min_timestamp_win(other._min_timestamp_win),
+        _min_timestamp_ptr(other._min_timestamp_ptr),
+        _min_timestamp_buf(other._min_timestamp_buf),
+        _group_count(other._group_count),
+        _group_of(std::move(other._group_of)),
+        _slot_of(std::move(other._slot_of)),
+        _slot_rank(std::move(other._slot_rank)),
+        _group_offset(std::move(other._group_offset)),
+        _group_buf(std::move(other._group_buf)), _info(other._info),
+        _spsc(std::move(other._spsc)),
+        _stats(other._stats) {
+    other._comm = MPI_COMM_NULL;
+    other._min_timestamp_win = MPI_WIN_NULL;
+    other._min_timestamp_ptr = nullptr;
+    other._min_timestamp_buf = nullptr;
+    other._info = MPI_INFO_NULL;
+  }
+
+  ~HierarchicalSlotQueue() {
+    if (this->_min_timestamp_win != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(_min_timestamp_win);
+      win_free(&this->_min_timestamp_win);
+    }
+    if (this->_info != MPI_INFO_NULL) {
+      MPI_Info_free(&this->_info);
+    }
+    if (this->_self_rank == this->_dequeuer_rank) {
+      delete[] this->_min_timestamp_buf;
+    }
+  }
+
+  // Collective; empties the queue in place, reusing its windows. Every
+  // enqueue must be complete and no rank may access the queue until all
+  // ranks have returned.
+  void reset() {
+    this->_counter.reset();
+    this->_spsc.reset();
+    if (this->_self_rank == this->_dequeuer_rank) {
+      for (int i = 0; i < this->_size + this->_group_count; ++i) {
+        this->_min_timestamp_ptr[i] = MAX_TIMESTAMP;
+      }
+    }
+    MPI_Win_flush_all(this->_min_timestamp_win);
+    MPI_Barrier(this->_comm);
+    MPI_Win_flush_all(this->_min_timestamp_win);
+  }
+
+  bool enqueue(const T &data) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    timestamp_t counter = this->_counter.get_and_increment();
+    data_t value{data, counter};
+    if (!this->_spsc.enqueue(value)) {
+      return false;
+    }
+    data_t front;
+    if (!this->_spsc.e_read_front(&front) || front.timestamp != counter) {
+      return true;
+    }
+    if (!this->_refreshEnqueue(counter)) {
+      this->_refreshEnqueue(counter);
+    }
+    const MPI_Aint group = this->_group_of[this->_self_rank];
+    if (!this->_refreshGroup(group, this->_dequeuer_rank)) {
+      this->_refreshGroup(group, this->_dequeuer_rank);
+    }
+    return true;
+  }
+
+  bool enqueue(const std::vector<T> &data) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    if (data.size() == 0) {
+      return true;
+    }
+
+    timestamp_t counter = this->_counter.get_and_increment();
+    std::vector<data_t> timestamped_data;
+    for (const T &datum : data) {
+      timestamped_data.push_back(data_t{datum, counter});
+    }
+    if (!this->_spsc.enqueue(timestamped_data)) {
+      return false;
+    }
+    data_t front;
+    if (!this->_spsc.e_read_front(&front) || front.timestamp != counter) {
+      return true;
+    }
+    if (!this->_refreshEnqueue(counter)) {
+      this->_refreshEnqueue(counter);
+    }
+    const MPI_Aint group = this->_group_of[this->_self_rank];
+    if (!this->_refreshGroup(group, this->_dequeuer_rank)) {
+      this->_refreshGroup(group, this->_dequeuer_rank);
+    }
+    return true;
+  }
+
+  bool dequeue(T *output) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    MPI_Aint rank = this->_readMinimumRank();
+    if (rank == DUMMY_RANK) {
+      stats_count_empty_dequeue();
+      return false;
+    }
+    data_t output_data;
+    bool res = this->_spsc.dequeue(&output_data, rank);
+    if (!res) {
+      stats_count_empty_dequeue();
+      return false;
+    }
+    *output = output_data.data;
+    if (!this->_refreshDequeue(rank)) {
+      this->_refreshDequeue(rank);
+    }
+    const MPI_Aint group = this->_group_of[rank];
+    if (!this->_refreshGroup(group, this->_self_rank)) {
+      this->_refreshGroup(group, this->_self_rank);
+    }
+    return true;
+  }
+
+  PublicationStats publication_stats() const {
+    return this->_spsc.publication_stats();
+  }
+
+  queue_stats_t stats() const { return this->_stats; }
+};
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "../lib/argmin.hpp"
+#include "../lib/comm.hpp"
+#include "../lib/distributed-counters/faa.hpp"
+#include "../lib/spsc/bounded_spsc.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mpi.h>
+#include <vector>
+
+// Multi-consumer slot-queue: the slots and the spsc indexes live on a host
+// rank, and any rank may dequeue. A dequeuer picks the minimum slot like
+// SlotQueue does, then claims the front item of that enqueuer by CAS on its
+// spsc first index; on a lost claim it refreshes the slot and scans again, so
+// dequeue is lock-free.
+template <typename T> class MpmcSlotQueue {
+private:
+  typedef uint64_t timestamp_t;
+  constexpr static timestamp_t MAX_TIMESTAMP = ~((uint64_t)0);
+  constexpr static MPI_Aint DUMMY_RANK = ~((MPI_Aint)0);
+
+  struct data_t {
+    T data;
+    uint64_t timestamp;
+  };
+
+  MPI_Comm _comm;
+  MPI_Aint _size;
+  int _self_rank;
+  const MPI_Aint _host_rank;
+
+  FaaCounter _counter;
+
+  MPI_Win _min_timestamp_win = MPI_WIN_NULL;
+  timestamp_t *_min_timestamp_ptr = nullptr;
+  timestamp_t *_min_timestamp_buf = nullptr;
+
+  MPI_Info _info = MPI_INFO_NULL;
+
+  Spsc<data_t> _spsc;
+
+  queue_stats_t _stats = {};
+
+private:
+  bool _refreshEnqueue(timestamp_t ts) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    data_t front;
+    // avoid possibily redundant remote read below
+    timestamp_t new_timestamp;
+    if (!this->_spsc.e_read_front(&front)) {
+      new_timestamp = MAX_TIMESTAMP;
+    } else {
+      new_timestamp = front.timestamp;
+    }
+    if (new_timestamp != ts) {
+      return true;
+    }
+
+    timestamp_t old_timestamp;
+    fetch_and_add_sync(&old_timestamp, 0, this->_self_rank, this->_host_rank,
+                       this->_min_timestamp_win);
+    if (!this->_spsc.e_read_front(&front)) {
+      new_timestamp = MAX_TIMESTAMP;
+    } else {
+      new_timestamp = front.timestamp;
+    }
+    if (new_timestamp != ts) {
+      return true;
+    }
+    timestamp_t result;
+    compare_and_swap_sync(&old_timestamp, &new_timestamp, &result,
+                          this->_self_rank, this->_host_rank,
+                          this->_min_timestamp_win);
+    return result == old_timestamp;
+  }
+
+private:
+  MPI_Aint _readMinimumRank() {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+
+    batch_aread_sync(this->_min_timestamp_buf, this->_size, 0,
+                     this->_host_rank, this->_min_timestamp_win);
+    MPI_Aint rank = argmin(this->_min_timestamp_buf, this->_size);
+    timestamp_t min_timestamp = this->_min_timestamp_buf[rank];
+    if (min_timestamp == MAX_TIMESTAMP) {
+      return DUMMY_RANK;
+    }
+    if (rank > 0) {
+      batch_aread_sync(this->_min_timestamp_buf, rank, 0, this->_host_rank,
+                       this->_min_timestamp_win);
+      MPI_Aint prefix_rank = argmin(this->_min_timestamp_buf, rank);
+      if (this->_min_timestamp_buf[prefix_rank] < min_timestamp) {
+        rank = prefix_rank;
+      }
+    }
+    return rank;
+  }
+
+  bool _refreshDequeue(MPI_Aint rank) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+
+    timestamp_t old_timestamp;
+    fetch_and_add_sync(&old_timestamp, 0, rank, this->_host_rank,
+                       this->_min_timestamp_win);
+    data_t front;
+    timestamp_t new_timestamp;
+    if (!this->_spsc.d_shared_read_front(&front, rank)) {
+      new_timestamp = MAX_TIMESTAMP;
+    } else {
+      new_timestamp = front.timestamp;
+    }
+    timestamp_t result;
+    compare_and_swap_sync(&old_timestamp, &new_timestamp, &result, rank,
+                          this->_host_rank, this->_min_timestamp_win);
+    return result == old_timestamp;
+  }
+
+public:
+  MpmcSlotQueue(MPI_Aint capacity_per_node, MPI_Aint host_rank, MPI_Comm comm)
+      : _comm{comm}, _host_rank{host_rank},
+        _counter{host_rank, comm}, _spsc{capacity_per_node, host_rank, comm} {
+    int size;
+    MPI_Comm_rank(comm, &this->_self_rank);
+    MPI_Comm_size(comm, &size);
+    this->_size = size;
+
+    MPI_Info_create(&this->_info);
+    MPI_Info_set(this->_info, "same_disp_unit", "true");
+    MPI_Info_set(this->_info, "accumulate_ordering", "none");
+    MPI_Info_set(this->_info, "which_accumulate_ops", "no_op,sum,cswap");
+
+    if (this->_self_rank == this->_host_rank) {
+      win_allocate(this->_size * sizeof(timestamp_t), sizeof(timestamp_t),
+                   this->_info, comm, &this->_min_timestamp_ptr,
+                   &this->_min_timestamp_win);
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_min_timestamp_win);
+
+      for (int i = 0; i < this->_size; ++i) {
+        this->_min_timestamp_ptr[i] = MAX_TIMESTAMP;
+      }
+    } else {
+      win_allocate(0, sizeof(timestamp_t), this->_info, comm,
+                   &this->_min_timestamp_ptr, &this->_min_timestamp_win);
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, _min_timestamp_win);
+    }
+    this->_min_timestamp_buf = new timestamp_t[this->_size];
+    MPI_Win_flush_all(this->_min_timestamp_win);
+    MPI_Barrier(comm);
+    MPI_Win_flush_all(this->_min_timestamp_win);
+  }
+
+  MpmcSlotQueue(const MpmcSlotQueue &) = delete;
+  MpmcSlotQueue &operator=(const MpmcSlotQueue &) = delete;
+
+  MpmcSlotQueue(MpmcSlotQueue &&other) noexcept
+      : _comm(other._comm), _size(other._size), _self_rank(other._self_rank),
+        _host_rank(other._host_rank), _counter(std::move(other._counter)),
+        _min_timestamp_win(other._min_timestamp_win),
+        _min_timestamp_ptr(other._min_timestamp_ptr),
+        _min_timestamp_buf(other._min_timestamp_buf), _info(other._info),
+        _spsc(std::move(other._spsc)),
+        _stats(other._stats) {
+    other._comm = MPI_COMM_NULL;
+    other._min_timestamp_win = MPI_WIN_NULL;
+    other._min_timestamp_ptr = nullptr;
+    other._min_timestamp_buf = nullptr;
+    other._info = MPI_INFO_NULL;
+  }
+
+  ~MpmcSlotQueue() {
+    if (this->_min_timestamp_win != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(_min_timestamp_win);
+      win_free(&this->_min_timestamp_win);
+    }
+    if (this->_info != MPI_INFO_NULL) {
+      MPI_Info_free(&this->_info);
+    }
+    delete[] this->_min_timestamp_buf;
+  }
+
+  // Collective; empties the queue in place, reusing its windows. Every
+  // enqueue must be complete and no rank may access the queue until all
+  // ranks have returned.
+  void reset() {
+    this->_counter.reset();
+    this->_spsc.reset();
+    if (this->_self_rank == this->_host_rank) {
+      for (int i = 0; i < this->_size; ++i) {
+        this->_min_timestamp_ptr[i] = MAX_TIMESTAMP;
+      }
+    }
+    MPI_Win_flush_all(this->_min_timestamp_win);
+    MPI_Barrier(this->_comm);
+    MPI_Win_flush_all(this->_min_timestamp_win);
+  }
+
+  bool enqueue(const T &data) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    timestamp_t counter = this->_counter.get_and_increment();
+    data_t value{data, counter};
+    bool res = this->_spsc.enqueue(value);
+    if (!res) {
+      return false;
+    }
+    if (!this->_refreshEnqueue(counter)) {
+      this->_refreshEnqueue(counter);
+    }
+    return res;
+  }
+
+  bool enqueue(const std::vector<T> &data) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    if (data.size() == 0) {
+      return true;
+    }
+
+    timestamp_t counter = this->_counter.get_and_increment();
+    std::vector<data_t> timestamped_data;
+    for (const T &datum : data) {
+      timestamped_data.push_back(data_t{datum, counter});
+    }
+    bool res = this->_spsc.enqueue(timestamped_data);
+    if (!res) {
+      return false;
+    }
+    if (!this->_refreshEnqueue(counter)) {
+      this->_refreshEnqueue(counter);
+    }
+    return res;
+  }
+
+  bool dequeue(T *output) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    while (true) {
+      MPI_Aint rank = this->_readMinimumRank();
+      if (rank == DUMMY_RANK) {
+        stats_count_empty_dequeue();
+        return false;
+      }
+      data_t output_data;
+      bool res = this->_spsc.d_claim(&output_data, rank);
+      if (!this->_refreshDequeue(rank)) {
+        this->_refreshDequeue(rank);
+      }
+      if (res) {
+        *output = output_data.data;
+        return true;
+      }
+    }
+  }
+
+  queue_stats_t stats() const { return this->_stats; }
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../lib/argmin.hpp"
 #include "../lib/comm.hpp"
 #include "../lib/distributed-counters/faa.hpp"
 #include "../lib/spsc/unbounded_spsc.hpp"
@@ -35,6 +36,8 @@ private:
 
   UnboundedSpsc<data_t> _spsc;
 
+  queue_stats_t _stats = {};
+
 private:
   bool _refreshEnqueue(timestamp_t ts) {
 #ifdef PROFILE
@@ -71,37 +74,34 @@ private:
   }
 
 private:
-  MPI_Aint _readMinimumRank() {
+  MPI_Aint _readMinimumRank(timestamp_t *next_timestamp = nullptr) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
 
-    MPI_Aint rank = DUMMY_RANK;
-    timestamp_t min_timestamp = MAX_TIMESTAMP;
-
-    for (int i = 0; i < this->_size; ++i) {
-      aread_sync(&this->_min_timestamp_buf[i], i, this->_self_rank,
-                 this->_min_timestamp_win);
-    }
-    for (int i = 0; i < this->_size; ++i) {
-      timestamp_t timestamp = this->_min_timestamp_buf[i];
-      if (timestamp < min_timestamp) {
-        rank = i;
-        min_timestamp = timestamp;
-      }
-    }
-    if (rank == DUMMY_RANK) {
+    batch_aread_sync(this->_min_timestamp_buf, this->_size, 0,
+                     this->_self_rank, this->_min_timestamp_win);
+    MPI_Aint rank = argmin(this->_min_timestamp_buf, this->_size);
+    timestamp_t min_timestamp = this->_min_timestamp_buf[rank];
+    if (min_timestamp == MAX_TIMESTAMP) {
       return DUMMY_RANK;
     }
-    for (int i = 0; i < rank; ++i) {
-      aread_sync(&this->_min_timestamp_buf[i], i, this->_self_rank,
-                 this->_min_timestamp_win);
+    if (rank > 0) {
+      batch_aread_sync(this->_min_timestamp_buf, rank, 0, this->_self_rank,
+                       this->_min_timestamp_win);
+      MPI_Aint prefix_rank = argmin(this->_min_timestamp_buf, rank);
+      if (this->_min_timestamp_buf[prefix_rank] < min_timestamp) {
+        rank = prefix_rank;
+        min_timestamp = this->_min_timestamp_buf[prefix_rank];
+      }
     }
-    for (int i = 0; i < rank; ++i) {
-      timestamp_t timestamp = this->_min_timestamp_buf[i];
-      if (timestamp < min_timestamp) {
-        rank = i;
-        min_timestamp = timestamp;
+    if (next_timestamp != nullptr) {
+      // the smallest timestamp seen in any other slot during the scans
+      *next_timestamp = MAX_TIMESTAMP;
+      for (int i = 0; i < this->_size; ++i) {
+        if (i != rank && this->_min_timestamp_buf[i] < *next_timestamp) {
+          *next_timestamp = this->_min_timestamp_buf[i];
+        }
       }
     }
     return rank;
@@ -140,11 +140,12 @@ public:
     MPI_Info_create(&this->_info);
     MPI_Info_set(this->_info, "same_disp_unit", "true");
     MPI_Info_set(this->_info, "accumulate_ordering", "none");
+    MPI_Info_set(this->_info, "which_accumulate_ops", "no_op,sum,cswap");
 
     if (this->_self_rank == this->_dequeuer_rank) {
-      MPI_Win_allocate(this->_size * sizeof(timestamp_t), sizeof(timestamp_t),
-                       this->_info, comm, &this->_min_timestamp_ptr,
-                       &this->_min_timestamp_win);
+      win_allocate(this->_size * sizeof(timestamp_t), sizeof(timestamp_t),
+                   this->_info, comm, &this->_min_timestamp_ptr,
+                   &this->_min_timestamp_win);
       MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_min_timestamp_win);
 
       for (int i = 0; i < this->_size; ++i) {
@@ -152,8 +153,8 @@ public:
       }
       this->_min_timestamp_buf = new timestamp_t[this->_size];
     } else {
-      MPI_Win_allocate(0, sizeof(timestamp_t), this->_info, comm,
-                       &this->_min_timestamp_ptr, &this->_min_timestamp_win);
+      win_allocate(0, sizeof(timestamp_t), this->_info, comm,
+                   &this->_min_timestamp_ptr, &this->_min_timestamp_win);
       MPI_Win_lock_all(MPI_MODE_NOCHECK, _min_timestamp_win);
     }
     MPI_Win_flush_all(this->_min_timestamp_win);
@@ -171,7 +172,8 @@ public:
         _min_timestamp_win(other._min_timestamp_win),
         _min_timestamp_ptr(other._min_timestamp_ptr),
         _min_timestamp_buf(other._min_timestamp_buf), _info(other._info),
-        _spsc(std::move(other._spsc)) {
+        _spsc(std::move(other._spsc)),
+        _stats(other._stats) {
     other._comm = MPI_COMM_NULL;
     other._min_timestamp_win = MPI_WIN_NULL;
     other._min_timestamp_ptr = nullptr;
@@ -182,7 +184,7 @@ public:
   ~UnboundedSlotQueue() {
     if (this->_min_timestamp_win != MPI_WIN_NULL) {
       MPI_Win_unlock_all(_min_timestamp_win);
-      MPI_Win_free(&this->_min_timestamp_win);
+      win_free(&this->_min_timestamp_win);
     }
     if (this->_info != MPI_INFO_NULL) {
       MPI_Info_free(&this->_info);
@@ -196,6 +198,7 @@ public:
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     timestamp_t counter = this->_counter.get_and_increment();
     data_t value{data, counter};
@@ -213,6 +216,7 @@ public:
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     if (data.size() == 0) {
       return true;
@@ -237,14 +241,17 @@ public:
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     MPI_Aint rank = this->_readMinimumRank();
     if (rank == DUMMY_RANK) {
+      stats_count_empty_dequeue();
       return false;
     }
     data_t output_data;
     bool res = this->_spsc.dequeue(&output_data, rank);
     if (!res) {
+      stats_count_empty_dequeue();
       return false;
     }
     *output = output_data.data;
@@ -253,4 +260,47 @@ public:
     }
     return true;
   }
+
+  // Dequeue up to `max` items with a single slot scan: after the minimum slot
+  // is found, items are drained from its spsc as long as their timestamps do
+  // not exceed the next smallest slot, then the slot is refreshed once.
+  bool dequeue(std::vector<T> &output, size_t max) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    if (max == 0) {
+      return false;
+    }
+    timestamp_t next_timestamp;
+    MPI_Aint rank = this->_readMinimumRank(&next_timestamp);
+    if (rank == DUMMY_RANK) {
+      stats_count_empty_dequeue();
+      return false;
+    }
+    data_t output_data;
+    size_t count = 0;
+    while (count < max) {
+      if (count > 0 && (!this->_spsc.d_read_front(&output_data, rank) ||
+                        output_data.timestamp > next_timestamp)) {
+        break;
+      }
+      if (!this->_spsc.dequeue(&output_data, rank)) {
+        break;
+      }
+      output.push_back(output_data.data);
+      ++count;
+    }
+    if (count == 0) {
+      stats_count_empty_dequeue();
+      return false;
+    }
+    if (!this->_refreshDequeue(rank)) {
+      this->_refreshDequeue(rank);
+    }
+    return true;
+  }
+
+  queue_stats_t stats() const { return this->_stats; }
 };
@@ -1,107 +1,155 @@
 #pragma once
 
+#include "../lib/argmin.hpp"
 #include "../lib/comm.hpp"
+#include "../lib/distributed-counters/clock.hpp"
 #include "../lib/distributed-counters/faa.hpp"
-#include "../lib/spsc/bounded_spsc.hpp"
+#include "../lib/queue_arena.hpp"
+#include "../lib/spsc/record_spsc.hpp"
+#include "../lib/vector_fifo.hpp"
+#include "../lib/window_layout.hpp"
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
 #include <mpi.h>
 #include <vector>
 
-template <typename T> class SlotQueue {
+// `Counter` is the timestamp source: FaaCounter (a shared remote counter) or
+// ClockCounter (synchronized local clocks, FIFO only up to the clock skew).
+template <typename T, typename Counter = FaaCounter> class SlotQueue {
 private:
   typedef uint64_t timestamp_t;
   constexpr static timestamp_t MAX_TIMESTAMP = ~((uint64_t)0);
   constexpr static MPI_Aint DUMMY_RANK = ~((MPI_Aint)0);
 
-  struct data_t {
-    T data;
-    uint64_t timestamp;
-  };
-
   MPI_Comm _comm;
   MPI_Aint _size;
   int _self_rank;
   const MPI_Aint _dequeuer_rank;
 
-  FaaCounter _counter;
+  Counter _counter;
+
+  MPI_Win _win = MPI_WIN_NULL;
+  // False when the regions live in a QueueArena's window.
+  bool _owns_win = true;
 
-  MPI_Win _min_timestamp_win = MPI_WIN_NULL;
+  WindowLayout::Region<timestamp_t> _min_timestamp_region;
   timestamp_t *_min_timestamp_ptr = nullptr;
   timestamp_t *_min_timestamp_buf = nullptr;
 
   MPI_Info _info = MPI_INFO_NULL;
 
-  Spsc<data_t> _spsc;
+  // An enqueue's items share one timestamp, stored once per record.
+  RecordSpsc<T, timestamp_t> _spsc;
+
+  struct pending_enqueue_t {
+    std::vector<T> data;
+    MPI_Aint counter;
+    MPI_Request request = MPI_REQUEST_NULL;
+    bool issued = false;
+    bool done = false;
+    bool succeeded = false;
+  };
+  VectorFifo<std::shared_ptr<pending_enqueue_t>> _pending;
+  // Completed states that no handle refers to anymore, reused along with
+  // their buffers.
+  std::vector<std::shared_ptr<pending_enqueue_t>> _free_pending;
+
+  queue_stats_t _stats = {};
 
 private:
+  bool _enqueue(const T &data, timestamp_t counter) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+
+    bool res = this->_spsc.enqueue(data, counter);
+    if (!res) {
+      return false;
+    }
+    if (!this->_refreshEnqueue(counter)) {
+      this->_refreshEnqueue(counter);
+    }
+    return res;
+  }
+
+  bool _enqueue(const T *data, size_t size, timestamp_t counter) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+
+    bool res = this->_spsc.enqueue(data, size, counter);
+    if (!res) {
+      return false;
+    }
+    if (!this->_refreshEnqueue(counter)) {
+      this->_refreshEnqueue(counter);
+    }
+    return res;
+  }
+
   bool _refreshEnqueue(timestamp_t ts) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
-    data_t front;
     // avoid possibily redundant remote read below
     timestamp_t new_timestamp;
-    if (!this->_spsc.e_read_front(&front)) {
+    if (!this->_spsc.e_read_front(&new_timestamp)) {
       new_timestamp = MAX_TIMESTAMP;
-    } else {
-      new_timestamp = front.timestamp;
     }
     if (new_timestamp != ts) {
       return true;
     }
 
     timestamp_t old_timestamp;
-    fetch_and_add_sync(&old_timestamp, 0, this->_self_rank,
-                       this->_dequeuer_rank, this->_min_timestamp_win);
-    if (!this->_spsc.e_read_front(&front)) {
+    fetch_and_add_sync(&old_timestamp, 0,
+                       this->_min_timestamp_region.disp(this->_self_rank),
+                       this->_dequeuer_rank, this->_win);
+    if (!this->_spsc.e_read_front(&new_timestamp)) {
       new_timestamp = MAX_TIMESTAMP;
-    } else {
-      new_timestamp = front.timestamp;
     }
     if (new_timestamp != ts) {
       return true;
     }
     timestamp_t result;
     compare_and_swap_sync(&old_timestamp, &new_timestamp, &result,
-                          this->_self_rank, this->_dequeuer_rank,
-                          this->_min_timestamp_win);
+                          this->_min_timestamp_region.disp(this->_self_rank),
+                          this->_dequeuer_rank, this->_win);
     return result == old_timestamp;
   }
 
 private:
-  MPI_Aint _readMinimumRank() {
+  MPI_Aint _readMinimumRank(timestamp_t *next_timestamp = nullptr) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
 
-    MPI_Aint rank = DUMMY_RANK;
-    timestamp_t min_timestamp = MAX_TIMESTAMP;
-
-    for (int i = 0; i < this->_size; ++i) {
-      aread_sync(&this->_min_timestamp_buf[i], i, this->_self_rank,
-                 this->_min_timestamp_win);
-    }
-    for (int i = 0; i < this->_size; ++i) {
-      timestamp_t timestamp = this->_min_timestamp_buf[i];
-      if (timestamp < min_timestamp) {
-        rank = i;
-        min_timestamp = timestamp;
-      }
-    }
-    if (rank == DUMMY_RANK) {
+    batch_aread_sync(this->_min_timestamp_buf, this->_size,
+                     this->_min_timestamp_region.disp(0), this->_self_rank,
+                     this->_win);
+    MPI_Aint rank = argmin(this->_min_timestamp_buf, this->_size);
+    timestamp_t min_timestamp = this->_min_timestamp_buf[rank];
+    if (min_timestamp == MAX_TIMESTAMP) {
       return DUMMY_RANK;
     }
-    for (int i = 0; i < rank; ++i) {
-      aread_sync(&this->_min_timestamp_buf[i], i, this->_self_rank,
-                 this->_min_timestamp_win);
+    if (rank > 0) {
+      batch_aread_sync(this->_min_timestamp_buf, rank,
+                       this->_min_timestamp_region.disp(0), this->_self_rank,
+                       this->_win);
+      MPI_Aint prefix_rank = argmin(this->_min_timestamp_buf, rank);
+      if (this->_min_timestamp_buf[prefix_rank] < min_timestamp) {
+        rank = prefix_rank;
+        min_timestamp = this->_min_timestamp_buf[prefix_rank];
+      }
     }
-    for (int i = 0; i < rank; ++i) {
-      timestamp_t timestamp = this->_min_timestamp_buf[i];
-      if (timestamp < min_timestamp) {
-        rank = i;
-        min_timestamp = timestamp;
+    if (next_timestamp != nullptr) {
+      // the smallest timestamp seen in any other slot during the scans
+      *next_timestamp = MAX_TIMESTAMP;
+      for (int i = 0; i < this->_size; ++i) {
+        if (i != rank && this->_min_timestamp_buf[i] < *next_timestamp) {
+          *next_timestamp = this->_min_timestamp_buf[i];
+        }
       }
     }
     return rank;
@@ -113,26 +161,112 @@ private:
 #endif
 
     timestamp_t old_timestamp;
-    fetch_and_add_sync(&old_timestamp, 0, rank, this->_self_rank,
-                       this->_min_timestamp_win);
-    data_t front;
+    fetch_and_add_sync(&old_timestamp, 0,
+                       this->_min_timestamp_region.disp(rank), this->_self_rank,
+                       this->_win);
     timestamp_t new_timestamp;
-    if (!this->_spsc.d_read_front(&front, rank)) {
+    if (!this->_spsc.d_read_front(&new_timestamp, rank)) {
       new_timestamp = MAX_TIMESTAMP;
-    } else {
-      new_timestamp = front.timestamp;
     }
     timestamp_t result;
-    compare_and_swap_sync(&old_timestamp, &new_timestamp, &result, rank,
-                          this->_self_rank, this->_min_timestamp_win);
+    compare_and_swap_sync(&old_timestamp, &new_timestamp, &result,
+                          this->_min_timestamp_region.disp(rank),
+                          this->_self_rank, this->_win);
     return result == old_timestamp;
   }
 
+  void _add_regions(WindowLayout &layout) {
+    this->_min_timestamp_region = layout.add<timestamp_t>(
+        this->_size, this->_self_rank == this->_dequeuer_rank);
+  }
+
+  // Initializes the regions hosted by this rank; the window must be locked.
+  void _initialize(void *base) {
+    if (this->_self_rank == this->_dequeuer_rank) {
+      this->_min_timestamp_ptr = this->_min_timestamp_region.ptr(base);
+      this->_min_timestamp_buf = new timestamp_t[this->_size];
+    }
+    this->_reset_regions();
+  }
+
+  void _reset_regions() {
+    if (this->_self_rank == this->_dequeuer_rank) {
+      for (int i = 0; i < this->_size; ++i) {
+        this->_min_timestamp_ptr[i] = MAX_TIMESTAMP;
+      }
+    }
+  }
+
+public:
+  // Completion handle of enqueue_deferred. It must not outlive its queue, and
+  // the queue must not be moved while enqueues are pending.
+  class EnqueueHandle {
+    SlotQueue *_queue;
+    std::shared_ptr<pending_enqueue_t> _state;
+
+  public:
+    EnqueueHandle(SlotQueue *queue, std::shared_ptr<pending_enqueue_t> state)
+        : _queue{queue}, _state{std::move(state)} {}
+
+    bool test() {
+      if (!this->_state->done) {
+        this->_queue->progress();
+      }
+      return this->_state->done;
+    }
+
+    // Returns whether the enqueue succeeded.
+    bool wait() {
+      while (!this->_state->done) {
+        this->_queue->progress();
+      }
+      return this->_state->succeeded;
+    }
+  };
+
+private:
+  std::shared_ptr<pending_enqueue_t> _acquire_pending() {
+    if (this->_free_pending.empty()) {
+      return std::make_shared<pending_enqueue_t>();
+    }
+    std::shared_ptr<pending_enqueue_t> state =
+        std::move(this->_free_pending.back());
+    this->_free_pending.pop_back();
+    state->request = MPI_REQUEST_NULL;
+    state->issued = false;
+    state->done = false;
+    state->succeeded = false;
+    return state;
+  }
+
+  EnqueueHandle _enqueueDeferred(const T *data, size_t size) {
+    std::shared_ptr<pending_enqueue_t> state = this->_acquire_pending();
+    state->data.assign(data, data + size);
+    if (state->data.empty()) {
+      state->done = true;
+      state->succeeded = true;
+      return EnqueueHandle(this, state);
+    }
+    // One counter request in flight per queue, so timestamps stay in
+    // enqueue order even without accumulate ordering.
+    if (this->_pending.empty()) {
+      this->_counter.get_and_increment_async(&state->counter, &state->request);
+      state->issued = true;
+    }
+    this->_pending.push_back(state);
+    return EnqueueHandle(this, state);
+  }
+
 public:
-  SlotQueue(MPI_Aint capacity_per_node, MPI_Aint dequeuer_rank, MPI_Comm comm)
+  SlotQueue(MPI_Aint capacity_per_node, MPI_Aint dequeuer_rank, MPI_Comm comm,
+            MPI_Aint batch_size = 10,
+            LastPublication publication = LastPublication::EVERY_N,
+            MPI_Aint publication_interval = 10,
+            MPI_Aint lease_size = 1)
       : _comm{comm}, _dequeuer_rank{dequeuer_rank},
-        _spsc{capacity_per_node, dequeuer_rank, comm},
-        _counter{dequeuer_rank, comm} {
+        _spsc{capacity_per_node, dequeuer_rank, comm, batch_size, publication,
+              publication_interval},
+        _counter{dequeuer_rank, comm, lease_size} {
     int size;
     MPI_Comm_rank(comm, &this->_self_rank);
     MPI_Comm_size(comm, &size);
@@ -141,25 +275,48 @@ public:
     MPI_Info_create(&this->_info);
     MPI_Info_set(this->_info, "same_disp_unit", "true");
     MPI_Info_set(this->_info, "accumulate_ordering", "none");
+    MPI_Info_set(this->_info, "which_accumulate_ops", "no_op,sum,cswap");
 
-    if (this->_self_rank == this->_dequeuer_rank) {
-      MPI_Win_allocate(this->_size * sizeof(timestamp_t), sizeof(timestamp_t),
-                       this->_info, comm, &this->_min_timestamp_ptr,
-                       &this->_min_timestamp_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_min_timestamp_win);
-
-      for (int i = 0; i < this->_size; ++i) {
-        this->_min_timestamp_ptr[i] = MAX_TIMESTAMP;
-      }
-      this->_min_timestamp_buf = new timestamp_t[this->_size];
-    } else {
-      MPI_Win_allocate(0, sizeof(timestamp_t), this->_info, comm,
-                       &this->_min_timestamp_ptr, &this->_min_timestamp_win);
-      MPI_Win_lock_all(MPI_MODE_NOCHECK, _min_timestamp_win);
-    }
-    MPI_Win_flush_all(this->_min_timestamp_win);
+    WindowLayout layout;
+    this->_add_regions(layout);
+    void *base = layout.allocate(this->_info, comm, &this->_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, this->_win);
+    this->_initialize(base);
+    MPI_Win_flush_all(this->_win);
     MPI_Barrier(comm);
-    MPI_Win_flush_all(this->_min_timestamp_win);
+    MPI_Win_flush_all(this->_win);
+  }
+
+  // Carves the queue, its counter and its SPSCs from `arena`; see QueueArena
+  // for the protocol.
+  SlotQueue(MPI_Aint capacity_per_node, MPI_Aint dequeuer_rank,
+            QueueArena &arena, MPI_Aint batch_size = 10,
+            LastPublication publication = LastPublication::EVERY_N,
+            MPI_Aint publication_interval = 10,
+            MPI_Aint lease_size = 1)
+      : _comm{arena.comm()}, _dequeuer_rank{dequeuer_rank},
+        _counter{dequeuer_rank, arena, lease_size}, _win{arena.win()},
+        _owns_win{false},
+        _spsc{capacity_per_node, dequeuer_rank, arena, batch_size,
+              publication, publication_interval} {
+    int size;
+    MPI_Comm_rank(this->_comm, &this->_self_rank);
+    MPI_Comm_size(this->_comm, &size);
+    this->_size = size;
+
+    WindowLayout layout = arena.layout();
+    this->_add_regions(layout);
+    this->_initialize(arena.allocate(layout));
+  }
+
+  // Arena space one queue takes on a communicator of `comm_size` ranks.
+  static MPI_Aint arena_size(MPI_Aint capacity_per_node, int comm_size) {
+    WindowLayout layout;
+    layout.add<timestamp_t>(comm_size, true);
+    return Counter::arena_size() +
+           RecordSpsc<T, timestamp_t>::arena_size(capacity_per_node,
+                                                  comm_size) +
+           QueueArena::footprint(layout);
   }
 
   SlotQueue(const SlotQueue &) = delete;
@@ -169,21 +326,28 @@ public:
       : _comm(other._comm), _size(other._size), _self_rank(other._self_rank),
         _dequeuer_rank(other._dequeuer_rank),
         _counter(std::move(other._counter)),
-        _min_timestamp_win(other._min_timestamp_win),
+        _win(other._win), _owns_win(other._owns_win),
+        _min_timestamp_region(other._min_timestamp_region),
         _min_timestamp_ptr(other._min_timestamp_ptr),
         _min_timestamp_buf(other._min_timestamp_buf), _info(other._info),
-        _spsc(std::move(other._spsc)) {
+        _spsc(std::move(other._spsc)),
+        _pending(std::move(other._pending)),
+        _free_pending(std::move(other._free_pending)),
+        _stats(other._stats) {
     other._comm = MPI_COMM_NULL;
-    other._min_timestamp_win = MPI_WIN_NULL;
+    other._win = MPI_WIN_NULL;
     other._min_timestamp_ptr = nullptr;
     other._min_timestamp_buf = nullptr;
     other._info = MPI_INFO_NULL;
   }
 
   ~SlotQueue() {
-    if (this->_min_timestamp_win != MPI_WIN_NULL) {
-      MPI_Win_unlock_all(_min_timestamp_win);
-      MPI_Win_free(&this->_min_timestamp_win);
+    if (this->_win != MPI_WIN_NULL) {
+      this->wait_all();
+      if (this->_owns_win) {
+        MPI_Win_unlock_all(this->_win);
+        win_free(&this->_win);
+      }
     }
     if (this->_info != MPI_INFO_NULL) {
       MPI_Info_free(&this->_info);
@@ -193,65 +357,226 @@ public:
     }
   }
 
+  // Collective; empties the queue in place, reusing its windows. Every
+  // enqueue must be complete and no rank may access the queue until all
+  // ranks have returned.
+  void reset() {
+    this->reset_local();
+    MPI_Barrier(this->_comm);
+    MPI_Win_flush_all(this->_win);
+  }
+
+  // The part of reset() before its barrier, so that several queues can be
+  // reset behind a single barrier.
+  void reset_local() {
+    this->_counter.reset();
+    this->_spsc.reset();
+    this->_reset_regions();
+    MPI_Win_flush_all(this->_win);
+  }
+
+  // Completes this rank's deferred enqueues first, so that a producer's items
+  // stay in FIFO order across both kinds of enqueue.
   bool enqueue(const T &data) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
-    timestamp_t counter = this->_counter.get_and_increment();
-    data_t value{data, counter};
-    bool res = this->_spsc.enqueue(value);
-    if (!res) {
-      return false;
-    }
-    if (!this->_refreshEnqueue(counter)) {
-      this->_refreshEnqueue(counter);
-    }
-    return res;
+    this->wait_all();
+    return this->_enqueue(data, this->_counter.get_and_increment());
   }
 
   bool enqueue(const std::vector<T> &data) {
+    return this->enqueue(data.data(), data.size());
+  }
+
+  // Enqueues `size` items from `data` as one batch, without allocating.
+  bool enqueue(const T *data, size_t size) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
-    if (data.size() == 0) {
+    if (size == 0) {
       return true;
     }
+    this->wait_all();
+    return this->_enqueue(data, size, this->_counter.get_and_increment());
+  }
 
-    timestamp_t counter = this->_counter.get_and_increment();
-    std::vector<data_t> timestamped_data;
-    for (const T &datum : data) {
-      timestamped_data.push_back(data_t{datum, counter});
-    }
-    bool res = this->_spsc.enqueue(timestamped_data);
-    if (!res) {
+  // Room for items to construct in place, see reserve().
+  typedef typename RecordSpsc<T, timestamp_t>::reservation_t Reservation;
+
+  // Reserves room for `size` > 0 items and returns where to construct them,
+  // in this rank's ring when possible so they are written only once. `data`
+  // is nullptr if the queue is full. No other enqueue may happen until the
+  // reservation is committed.
+  Reservation reserve(size_t size) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    this->wait_all();
+    return this->_spsc.reserve(size);
+  }
+
+  // Enqueues the reserved items as one batch. Their timestamp is taken here,
+  // so they are ordered by commit rather than by reserve.
+  bool commit(const Reservation &reservation) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    if (reservation.data == nullptr) {
       return false;
     }
+    const timestamp_t counter = this->_counter.get_and_increment();
+    this->_spsc.commit(reservation, counter);
     if (!this->_refreshEnqueue(counter)) {
       this->_refreshEnqueue(counter);
     }
-    return res;
+    return true;
+  }
+
+  // Requests the enqueue's timestamp with a request-based FAA and defers the
+  // rest of it: the ring write, the last index publication and the slot refresh
+  // run with blocking RMA inside progress() or the handle's test()/wait(),
+  // which complete enqueues to the same queue in order.
+  EnqueueHandle enqueue_deferred(const T &data) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    return this->_enqueueDeferred(&data, 1);
+  }
+
+  EnqueueHandle enqueue_deferred(const std::vector<T> &data) {
+    return this->enqueue_deferred(data.data(), data.size());
+  }
+
+  // The items are copied into a pending state, recycled once the enqueue has
+  // completed and its handle is gone.
+  EnqueueHandle enqueue_deferred(const T *data, size_t size) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    return this->_enqueueDeferred(data, size);
+  }
+
+  // Completes pending enqueues in order, each with blocking RMA, until one's
+  // timestamp is not yet available.
+  void progress() {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    while (!this->_pending.empty()) {
+      pending_enqueue_t &head = *this->_pending.front();
+      if (!head.issued) {
+        this->_counter.get_and_increment_async(&head.counter, &head.request);
+        head.issued = true;
+      }
+      int completed;
+      MPI_Test(&head.request, &completed, MPI_STATUS_IGNORE);
+      if (!completed) {
+        return;
+      }
+      if (head.data.size() == 1) {
+        head.succeeded = this->_enqueue(head.data[0], head.counter);
+      } else {
+        head.succeeded = this->_enqueue(head.data.data(), head.data.size(),
+                                        head.counter);
+      }
+      head.done = true;
+      std::shared_ptr<pending_enqueue_t> state =
+          std::move(this->_pending.front());
+      this->_pending.pop_front();
+      if (state.use_count() == 1) {
+        this->_free_pending.push_back(std::move(state));
+      }
+    }
+  }
+
+  void wait_all() {
+    while (!this->_pending.empty()) {
+      this->progress();
+    }
   }
 
   bool dequeue(T *output) {
 #ifdef PROFILE
     CALI_CXX_MARK_FUNCTION;
 #endif
+    StatsScope stats_scope(this->_stats);
 
     MPI_Aint rank = this->_readMinimumRank();
     if (rank == DUMMY_RANK) {
+      stats_count_empty_dequeue();
       return false;
     }
-    data_t output_data;
-    bool res = this->_spsc.dequeue(&output_data, rank);
+    bool res = this->_spsc.dequeue(output, rank);
     if (!res) {
+      stats_count_empty_dequeue();
       return false;
     }
-    *output = output_data.data;
     if (!this->_refreshDequeue(rank)) {
       this->_refreshDequeue(rank);
     }
     return true;
   }
+
+  // Dequeue up to `max` items with a single slot scan: after the minimum slot
+  // is found, items are drained from its spsc as long as their timestamps do
+  // not exceed the next smallest slot, then the slot is refreshed once.
+  bool dequeue(std::vector<T> &output, size_t max) {
+#ifdef PROFILE
+    CALI_CXX_MARK_FUNCTION;
+#endif
+    StatsScope stats_scope(this->_stats);
+
+    if (max == 0) {
+      return false;
+    }
+    timestamp_t next_timestamp;
+    MPI_Aint rank = this->_readMinimumRank(&next_timestamp);
+    if (rank == DUMMY_RANK) {
+      stats_count_empty_dequeue();
+      return false;
+    }
+    // Drained a record at a time, its items sharing one timestamp
+    size_t count = 0;
+    while (count < max) {
+      timestamp_t front_timestamp;
+      if (count > 0 && (!this->_spsc.d_read_front(&front_timestamp, rank) ||
+                        front_timestamp > next_timestamp)) {
+        break;
+      }
+      const MPI_Aint dequeued = this->_spsc.dequeue(output, max - count, rank);
+      if (dequeued == 0) {
+        break;
+      }
+      count += dequeued;
+    }
+    if (count == 0) {
+      stats_count_empty_dequeue();
+      return false;
+    }
+    if (!this->_refreshDequeue(rank)) {
+      this->_refreshDequeue(rank);
+    }
+    return true;
+  }
+
+  PublicationStats publication_stats() const {
+    return this->_spsc.publication_stats();
+  }
+
+  queue_stats_t stats() const { return this->_stats; }
 };